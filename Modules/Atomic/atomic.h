@@ -0,0 +1,205 @@
+/*! @file
+ *
+ *  @brief Routines to access shared variables atomically without masking interrupts.
+ *
+ *  This contains loads and stores with memory barriers, and read-modify-write operations
+ *  built on the Cortex-M4 exclusive access instructions (LDREX/STREX).
+ *  When built for anything other than ARM (e.g. a Linux host, for stress testing), the same
+ *  functions are provided by the compiler's C11/C++11 atomic builtins.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-05-22
+ */
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__arm__)
+
+#include "fsl_common.h"
+
+/*! @brief Reads a variable written by another context.
+ *
+ *  Memory accesses after the load are not performed before it (acquire).
+ *  @param address A pointer to the variable.
+ *  @return uint32_t - the value of the variable.
+ */
+static inline uint32_t Atomic_Load(uint32_t volatile* const address)
+{
+  uint32_t value = *address;
+
+  __DMB();
+  return value;
+}
+
+/*! @brief Writes a variable read by another context.
+ *
+ *  Memory accesses before the store are completed before it (release).
+ *  @param address A pointer to the variable.
+ *  @param value The new value of the variable.
+ */
+static inline void Atomic_Store(uint32_t volatile* const address, const uint32_t value)
+{
+  __DMB();
+  *address = value;
+}
+
+/*! @brief Adds to a variable.
+ *
+ *  @param address A pointer to the variable.
+ *  @param value The amount to add.
+ *  @return uint32_t - the value of the variable before the addition.
+ */
+static inline uint32_t Atomic_FetchAdd(uint32_t volatile* const address, const uint32_t value)
+{
+  uint32_t old;
+
+  __DMB();
+  do
+  {
+    old = __LDREXW(address);
+  } while (__STREXW(old + value, address));
+  __DMB();
+
+  return old;
+}
+
+/*! @brief Replaces a variable if it still holds an expected value.
+ *
+ *  @param address A pointer to the variable.
+ *  @param expected The value the variable must hold for it to be replaced.
+ *  @param desired The new value of the variable.
+ *  @return bool - TRUE if the variable was replaced.
+ */
+static inline bool Atomic_CompareExchange(uint32_t volatile* const address, const uint32_t expected, const uint32_t desired)
+{
+  __DMB();
+  do
+  {
+    if (__LDREXW(address) != expected)
+    {
+      __CLREX();
+      return false;
+    }
+  } while (__STREXW(desired, address));
+  __DMB();
+
+  return true;
+}
+
+/*! @brief Sets bits in a variable.
+ *
+ *  @param address A pointer to the variable.
+ *  @param bits The bits to set.
+ *  @return uint32_t - the value of the variable before the bits were set.
+ */
+static inline uint32_t Atomic_SetBits(uint32_t volatile* const address, const uint32_t bits)
+{
+  uint32_t old;
+
+  __DMB();
+  do
+  {
+    old = __LDREXW(address);
+  } while (__STREXW(old | bits, address));
+  __DMB();
+
+  return old;
+}
+
+/*! @brief Clears bits in a variable.
+ *
+ *  @param address A pointer to the variable.
+ *  @param bits The bits to clear.
+ *  @return uint32_t - the value of the variable before the bits were cleared.
+ */
+static inline uint32_t Atomic_ClearBits(uint32_t volatile* const address, const uint32_t bits)
+{
+  uint32_t old;
+
+  __DMB();
+  do
+  {
+    old = __LDREXW(address);
+  } while (__STREXW(old & ~bits, address));
+  __DMB();
+
+  return old;
+}
+
+/*! @brief Reads a pointer written by another context.
+ *
+ *  @param address A pointer to the pointer.
+ *  @return void* - the value of the pointer.
+ */
+static inline void* Atomic_LoadPointer(void* volatile* const address)
+{
+  void* value = *address;
+
+  __DMB();
+  return value;
+}
+
+/*! @brief Writes a pointer read by another context.
+ *
+ *  @param address A pointer to the pointer.
+ *  @param value The new value of the pointer.
+ */
+static inline void Atomic_StorePointer(void* volatile* const address, void* const value)
+{
+  __DMB();
+  *address = value;
+}
+
+#else
+
+// Host build - the same functions on the compiler's atomic builtins (as used by C11 <stdatomic.h> and C++11 <atomic>)
+
+static inline uint32_t Atomic_Load(uint32_t volatile* const address)
+{
+  return __atomic_load_n(address, __ATOMIC_ACQUIRE);
+}
+
+static inline void Atomic_Store(uint32_t volatile* const address, const uint32_t value)
+{
+  __atomic_store_n(address, value, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t Atomic_FetchAdd(uint32_t volatile* const address, const uint32_t value)
+{
+  return __atomic_fetch_add(address, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool Atomic_CompareExchange(uint32_t volatile* const address, const uint32_t expected, const uint32_t desired)
+{
+  uint32_t value = expected;
+
+  return __atomic_compare_exchange_n(address, &value, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t Atomic_SetBits(uint32_t volatile* const address, const uint32_t bits)
+{
+  return __atomic_fetch_or(address, bits, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t Atomic_ClearBits(uint32_t volatile* const address, const uint32_t bits)
+{
+  return __atomic_fetch_and(address, ~bits, __ATOMIC_SEQ_CST);
+}
+
+static inline void* Atomic_LoadPointer(void* volatile* const address)
+{
+  return __atomic_load_n(address, __ATOMIC_ACQUIRE);
+}
+
+static inline void Atomic_StorePointer(void* volatile* const address, void* const value)
+{
+  __atomic_store_n(address, value, __ATOMIC_RELEASE);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,82 @@
+/*! @file
+ *
+ *  @brief Routines to calculate cyclic redundancy checks.
+ *
+ *  This contains the functions for calculating CRC-16/CCITT-FALSE and CRC-32 over blocks of bytes.
+ *  The K64's CRC peripheral does the work; the table-driven software versions are always available too,
+ *  and are used instead when built for anything other than ARM (e.g. a Linux host), with CRC_HW=0,
+ *  if the peripheral failed its check in CRC_Init, or while it is busy with another calculation.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-02
+ */
+
+#ifndef CRC_H
+#define CRC_H
+
+// new types
+#include "Types\types.h"
+#include <stddef.h>
+
+// Set to 0 to always calculate CRCs in software, rather than on the CRC peripheral when it is free
+#ifndef CRC_HW
+#define CRC_HW 1
+#endif
+
+// Set to 0 to skip checking the CRC peripheral against the standard check values in CRC_Init, which otherwise leaves
+// a peripheral that gets them wrong unused
+#ifndef CRC_SELF_TEST
+#define CRC_SELF_TEST 1
+#endif
+
+// Initial value of a CRC-16/CCITT-FALSE, to be passed to the first CRC_Calculate16 of a block
+#define CRC_16_INIT 0xFFFFU
+
+/*! @brief Sets up the CRC peripheral before first use, and with CRC_SELF_TEST checks it.
+ *
+ *  Until this has been called the CRCs are calculated in software, and they still are if the peripheral fails its check.
+ *  @return bool - TRUE if the CRC module was successfully initialized.
+ *  @note Does nothing if the CRCs are calculated in software.
+ */
+bool CRC_Init(void);
+
+/*! @brief Calculates the CRC-16/CCITT-FALSE (polynomial 0x1021, no reflection, no final XOR) of a block of bytes.
+ *
+ *  A block may be split over several calls by passing the result of one call as the crc of the next.
+ *  @param crc CRC_16_INIT, or the CRC of the bytes preceding data.
+ *  @param data A pointer to the bytes.
+ *  @param length The number of bytes.
+ *  @return uint16_t - the CRC of everything up to the end of data.
+ *  @note Reentrant - a call that interrupts another uses the table.
+ */
+uint16_t CRC_Calculate16(const uint16_t crc, const uint8_t* const data, const size_t length);
+
+/*! @brief Calculates the CRC-32 (polynomial 0x04C11DB7, reflected, as used by Ethernet and zip) of a block of bytes.
+ *
+ *  @param data A pointer to the bytes.
+ *  @param length The number of bytes.
+ *  @return uint32_t - the CRC.
+ *  @note Reentrant - a call that interrupts another uses the table.
+ */
+uint32_t CRC_Calculate32(const uint8_t* const data, const size_t length);
+
+/*! @brief Calculates a CRC-16/CCITT-FALSE with a 256-entry table, never using the CRC peripheral.
+ *
+ *  @param crc CRC_16_INIT, or the CRC of the bytes preceding data.
+ *  @param data A pointer to the bytes.
+ *  @param length The number of bytes.
+ *  @return uint16_t - the CRC of everything up to the end of data.
+ *  @note Reentrant.
+ */
+uint16_t CRC_Software16(const uint16_t crc, const uint8_t* const data, const size_t length);
+
+/*! @brief Calculates a CRC-32 with a 256-entry table, never using the CRC peripheral.
+ *
+ *  @param data A pointer to the bytes.
+ *  @param length The number of bytes.
+ *  @return uint32_t - the CRC.
+ *  @note Reentrant.
+ */
+uint32_t CRC_Software32(const uint8_t* const data, const size_t length);
+
+#endif
@@ -1,26 +1,131 @@
-/*! @file
+/*!
+**  @addtogroup Critical_module Critical module documentation
+**  @{
+*/
+/* MODULE Critical */
+/*! @file critical.c
  *
  *  @brief Routines to implement protection of critical sections.
  *
- *  This contains the functions for entering and exiting critical sections.
+ *  This contains the critical section profiler, which is only built when CRITICAL_PROFILE is 1.
+ *  Critical sections are timed with the DWT cycle counter, which must have been enabled (see Events_Init).
  *
- *  @author PMcL
- *  @date 2020-03-03
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-05-20
  */
 
+#include "critical.h"
+
+#if CRITICAL_PROFILE
+
+// Deepest nesting of critical sections that is timed
+#define MAX_DEPTH 8
+
 /*!
- *  @addtogroup Critical_module Critical module documentation
- *  @{
-*/
+ * @struct TEntry
+ */
+typedef struct
+{
+  uint32_t Site;	/*!< The address the critical section was entered from */
+  uint32_t Start;	/*!< The cycle count when the critical section was entered */
+} TEntry;
+
+static TCriticalProfile Profiles[CRITICAL_PROFILE_NB_SITES];
+static TEntry Stack[MAX_DEPTH];	// Critical sections that have been entered but not exited
+static uint32_t volatile Depth;	// Number of entries in Stack - a preempting section always restores it before returning
+
+
+/*! @brief Adds the duration of a critical section to the profile of its call site.
+ *
+ *  @param site The address the critical section was entered from.
+ *  @param cycles The time spent in the critical section.
+ */
+static void Record(const uint32_t site, const uint32_t cycles)
+{
+	uint8_t index, bucket;
+	uint32_t primask;
+
+	// Bucket 0 is under 64 cycles, then each bucket covers a factor of 4
+	if (cycles < 64)
+		bucket = 0;
+	else
+	{
+		bucket = ((31 - __CLZ(cycles)) - 6) / 2 + 1;
+		if (bucket >= CRITICAL_PROFILE_NB_BUCKETS)
+			bucket = CRITICAL_PROFILE_NB_BUCKETS - 1;
+	}
+
+	// A higher priority interrupt may be recording too, so hold everything off for the table update
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	for (index = 0; index < CRITICAL_PROFILE_NB_SITES; index++)
+	{
+		if ((Profiles[index].Site == site) || (Profiles[index].Site == 0))
+		{
+			Profiles[index].Site = site;
+			Profiles[index].Count++;
+			Profiles[index].Histogram[bucket]++;
+			if (cycles > Profiles[index].MaxCycles)
+				Profiles[index].MaxCycles = cycles;
+			break;
+		}
+	}
+
+	__set_PRIMASK(primask);
+}
+
+__attribute__((noinline)) uint32_t Critical_Enter(const uint8_t ceiling)
+{
+	uint32_t mask = __get_BASEPRI();
+	uint32_t depth;
+
+	__set_BASEPRI_MAX(CRITICAL_BASEPRI(ceiling));
+
+	// Claim a stack entry before filling it in, so a preempting section uses the next one
+	depth = Depth;
+	Depth = depth + 1;
+
+	if (depth < MAX_DEPTH)
+	{
+		Stack[depth].Site = (uint32_t)__builtin_return_address(0);
+		Stack[depth].Start = DWT->CYCCNT;
+	}
+
+	return mask;
+}
+
+__attribute__((noinline)) void Critical_Exit(const uint32_t mask)
+{
+	uint32_t now = DWT->CYCCNT;
+	uint32_t depth = Depth - 1;
+
+	if (depth < MAX_DEPTH)
+		Record(Stack[depth].Site, now - Stack[depth].Start);
+
+	Depth = depth;
+
+	__set_BASEPRI(mask);
+}
+
+bool Critical_GetProfile(const uint8_t index, TCriticalProfile* const profile)
+{
+	uint32_t primask;
+
+	if (index >= CRITICAL_PROFILE_NB_SITES)
+		return false;
 
-// Critical sections
-#include "Critical\critical.h"
+	primask = __get_PRIMASK();
+	__disable_irq();
+	*profile = Profiles[index];
+	__set_PRIMASK(primask);
 
-// Globals
+	return true;
+}
 
-volatile uint8_t SR_reg;  // Current value of the FAULTMASK register
-volatile uint8_t SR_lock = 0x00U;      // Lock
+#endif
 
+/* END Critical */
 /*!
- * @}
+** @}
 */
@@ -3,6 +3,17 @@
  *  @brief Routines to implement protection of critical sections.
  *
  *  This contains the functions for entering and exiting critical sections.
+ *  A critical section masks interrupts up to a priority ceiling using BASEPRI,
+ *  so interrupts with a higher priority than the ceiling keep running.
+ *  The previous mask is returned to the caller, so critical sections nest safely.
+ *
+ *  Usage:
+ *    uint32_t mask = Critical_Enter(MODULE_CRITICAL_CEILING);
+ *    ...
+ *    Critical_Exit(mask);
+ *
+ *  Building with CRITICAL_PROFILE=1 times every critical section with the DWT cycle counter
+ *  and keeps the worst case and a histogram of durations for each call site.
  *
  *  @author PMcL
  *  @date 2020-03-03
@@ -12,37 +23,84 @@
 #define CRITICAL_H
 
 #include <stdint.h>
-#include "critical.h"
-
-extern volatile uint8_t SR_reg;  // Current value of the FAULTMASK register
-extern volatile uint8_t SR_lock; // Lock
-
-// Save status register and disable interrupts
-#define EnterCritical() \
- do {\
-  uint8_t SR_reg_local;\
-   __asm ( \
-     "MRS R0, FAULTMASK\n\t" \
-     "CPSID f\n\t"            \
-     "STRB R0, %[output]"  \
-     : [output] "=m" (SR_reg_local)\
-     :: "r0");\
-   if (++SR_lock == 1u) {\
-     SR_reg = SR_reg_local;\
-   }\
- } while(0)
-
- 
-// Restore status register
-#define ExitCritical() \
- do {\
-   if (--SR_lock == 0u) { \
-     __asm (                 \
-       "LDRB R0, %[input]\n\t"\
-       "MSR FAULTMASK, R0;\n\t" \
-       ::[input] "m" (SR_reg)  \
-       : "r0");                \
-   }\
- } while(0)
+#include <stdbool.h>
+#include "fsl_common.h"
+
+// Interrupt priorities run from 0 (highest) to CRITICAL_PRIORITY_LOWEST
+#define CRITICAL_PRIORITY_LOWEST ((1U << __NVIC_PRIO_BITS) - 1)
+
+// Converts an interrupt priority to a BASEPRI value
+#define CRITICAL_BASEPRI(priority) ((uint32_t)(priority) << (8U - __NVIC_PRIO_BITS))
+
+// Set to 1 to time every critical section
+#ifndef CRITICAL_PROFILE
+#define CRITICAL_PROFILE 0
+#endif
+
+#if CRITICAL_PROFILE
+// Number of call sites that can be profiled
+#define CRITICAL_PROFILE_NB_SITES 16
+
+// Number of histogram buckets - bucket 0 counts sections under 64 cycles and each later bucket is 4 times wider
+#define CRITICAL_PROFILE_NB_BUCKETS 8
+
+/*!
+ * @struct TCriticalProfile
+ */
+typedef struct
+{
+  uint32_t Site;					/*!< The address the critical section was entered from, or 0 if unused */
+  uint32_t Count;					/*!< The number of times the critical section was entered */
+  uint32_t MaxCycles;					/*!< The longest time spent in the critical section */
+  uint32_t Histogram[CRITICAL_PROFILE_NB_BUCKETS];	/*!< The number of critical sections in each duration range */
+} TCriticalProfile;
+
+/*! @brief Masks all interrupts with a priority at or below a ceiling and starts timing the critical section.
+ *
+ *  @param ceiling The highest priority (lowest number) to mask, from 1 to CRITICAL_PRIORITY_LOWEST.
+ *  @return uint32_t - the previous mask, to be passed to Critical_Exit.
+ */
+uint32_t Critical_Enter(const uint8_t ceiling);
+
+/*! @brief Stops timing the critical section and restores the interrupt mask saved by Critical_Enter.
+ *
+ *  @param mask The value returned by the matching Critical_Enter.
+ */
+void Critical_Exit(const uint32_t mask);
+
+/*! @brief Takes a snapshot of the profile of one critical section call site.
+ *
+ *  @param index The index of the call site, from 0 to CRITICAL_PROFILE_NB_SITES - 1.
+ *  @param profile A pointer to a location to place the profile.
+ *  @return bool - TRUE if index is valid.
+ */
+bool Critical_GetProfile(const uint8_t index, TCriticalProfile* const profile);
+
+#else
+/*! @brief Masks all interrupts with a priority at or below a ceiling.
+ *
+ *  @param ceiling The highest priority (lowest number) to mask, from 1 to CRITICAL_PRIORITY_LOWEST.
+ *                 Interrupts with priority numbers less than ceiling keep running.
+ *  @return uint32_t - the previous mask, to be passed to Critical_Exit.
+ *  @note Entering a critical section never lowers the mask, so a nested section with a lower ceiling has no effect.
+ */
+static inline uint32_t Critical_Enter(const uint8_t ceiling)
+{
+  uint32_t mask = __get_BASEPRI();
+
+  __set_BASEPRI_MAX(CRITICAL_BASEPRI(ceiling));
+  return mask;
+}
+
+/*! @brief Restores the interrupt mask saved by Critical_Enter.
+ *
+ *  @param mask The value returned by the matching Critical_Enter.
+ */
+static inline void Critical_Exit(const uint32_t mask)
+{
+  __set_BASEPRI(mask);
+}
+
+#endif
 
 #endif
@@ -0,0 +1,102 @@
+/*!
+**  @addtogroup Events_module Events module documentation
+**  @{
+*/
+/* MODULE Events */
+/*! @file Events.c
+ *
+ *  @brief Routines to signal events from interrupts to the main loop.
+ *
+ *  This contains the functions for setting event flags and for sleeping until one is set.
+ *  Wake-up latency and idle time are measured with the DWT cycle counter.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-05-18
+ */
+
+#include "Events.h"
+#include "fsl_common.h"
+#include "Atomic\atomic.h"
+
+
+static uint32_t volatile EventFlags;	// Events set since the main loop last woke
+static uint32_t volatile EventTime;	// Cycle count when the first of EventFlags was set
+static uint32_t LastSample;		// Cycle count when the statistics were last brought up to date
+static TEventsStats Stats;
+
+
+bool Events_Init(void)
+{
+	// Enable the DWT cycle counter
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	EventFlags = 0;
+	LastSample = DWT->CYCCNT;
+
+	return true;
+}
+
+void Events_Set(const TEvent event)
+{
+	uint32_t now = DWT->CYCCNT;
+
+	// Set the flag atomically, as a higher priority interrupt may also be setting one
+	// Latency is measured from the first event the main loop has not yet seen
+	if (Atomic_SetBits(&EventFlags, event) == 0)
+		EventTime = now;
+}
+
+uint32_t Events_Wait(void)
+{
+	uint32_t events, sleepStart, now;
+
+	// Interrupts are held off while checking the flags so that one cannot be set between the check and the WFI
+	__disable_irq();
+
+	while (EventFlags == 0)
+	{
+		sleepStart = DWT->CYCCNT;
+		__WFI(); // wakes when an interrupt is pending, even though it cannot be taken yet
+		Stats.IdleCycles += DWT->CYCCNT - sleepStart;
+
+		// Let the pending interrupt run
+		__enable_irq();
+		__ISB();
+		__disable_irq();
+	}
+
+	events = EventFlags;
+	EventFlags = 0;
+	now = DWT->CYCCNT;
+
+	__enable_irq();
+
+	Stats.LastLatency = now - EventTime;
+	if (Stats.LastLatency > Stats.MaxLatency)
+		Stats.MaxLatency = Stats.LastLatency;
+
+	Stats.TotalCycles += now - LastSample;
+	LastSample = now;
+
+	return events;
+}
+
+void Events_GetStats(TEventsStats* const stats)
+{
+	uint32_t now = DWT->CYCCNT;
+
+	Stats.TotalCycles += now - LastSample;
+	LastSample = now;
+
+	*stats = Stats;
+
+	Stats.IdleCycles = 0;
+	Stats.TotalCycles = 0;
+}
+
+/* END Events */
+/*!
+** @}
+*/
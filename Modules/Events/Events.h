@@ -0,0 +1,67 @@
+/*! @file
+ *
+ *  @brief Routines to signal events from interrupts to the main loop.
+ *
+ *  This contains the functions for setting event flags and for sleeping until one is set.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-05-18
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+// new types
+#include "Types\types.h"
+
+/*! @brief Events that can wake the main loop - each is a separate bit.
+ *
+ */
+typedef enum
+{
+  EVENT_UART_RX = 0x01,		/*!< Data has been received by the UART */
+  EVENT_BAUD_TIMEOUT = 0x02,	/*!< The PC did not follow a baud rate change in time */
+  EVENT_PACKET_RX = 0x04,	/*!< A packet has been decoded by the UART receive interrupt */
+  EVENT_UART_TX = 0x08		/*!< A UART's transmit FIFO has emptied while the main loop was waiting for room in it */
+} TEvent;
+
+/*!
+ * @struct TEventsStats
+ */
+typedef struct
+{
+  uint32_t LastLatency;		/*!< Cycles from the most recent event being set to the main loop waking for it */
+  uint32_t MaxLatency;		/*!< The largest latency seen */
+  uint64_t IdleCycles;		/*!< Cycles spent asleep waiting for events */
+  uint64_t TotalCycles;		/*!< Cycles spent in total */
+} TEventsStats;
+
+/*! @brief Sets up the event flags and the DWT cycle counter before first use.
+ *
+ *  @return bool - TRUE if the events were successfully initialized.
+ */
+bool Events_Init(void);
+
+/*! @brief Sets an event flag to wake the main loop.
+ *
+ *  @param event The event to set.
+ *  @note May be called from any interrupt priority.
+ */
+void Events_Set(const TEvent event);
+
+/*! @brief Sleeps until at least one event flag is set, then clears and returns all of them.
+ *
+ *  @return uint32_t - the events that were set, as a mask of TEvent bits.
+ *  @note Must only be called from the main loop. Assumes that Events_Init has been called.
+ */
+uint32_t Events_Wait(void);
+
+/*! @brief Takes a snapshot of the wake-up latency and idle time, then restarts the idle time measurement.
+ *
+ *  @param stats A pointer to a location to place the statistics.
+ *  @note Must only be called from the main loop. Assumes that Events_Init has been called.
+ *  @note A single sleep longer than 2^32 cycles (about 35 s at 120 MHz) is not measured correctly.
+ */
+void Events_GetStats(TEventsStats* const stats);
+
+#endif
@@ -13,70 +13,321 @@
  *  @date 2020-03-18
  */
 
+#include <string.h>
+
 #include "FIFO.h"
-#include "Critical\critical.h"
-#include "fsl_common.h"
-#include "fsl_port.h"
+#include "Atomic\atomic.h"
+
+#if FIFO_STATS
+/*! @brief Records a put in the producer's statistics.
+ *
+ *  @param fifo A pointer to the FIFO.
+ *  @param requested The number of bytes the producer tried to put.
+ *  @param accepted The number of bytes actually put.
+ *  @param nbBytes The number of bytes in the FIFO after the put.
+ */
+static inline void StatsPut(TFIFO* const fifo, const size_t requested, const size_t accepted, const uint32_t nbBytes)
+{
+	fifo->Stats.NbPuts += accepted;
+	fifo->Stats.NbRejected += requested - accepted;
+
+	if (nbBytes > fifo->Stats.PeakNbBytes)
+		fifo->Stats.PeakNbBytes = nbBytes;
+
+	// Nearly full is within 1/8 of the capacity
+	if (nbBytes >= (fifo->Mask + 1) - ((fifo->Mask + 1) >> 3))
+		fifo->Stats.NbNearFull += requested;
+}
+
+/*! @brief Records a get in the consumer's statistics.
+ *
+ *  @param fifo A pointer to the FIFO.
+ *  @param nbBytes The number of bytes taken out of the FIFO.
+ */
+static inline void StatsGet(TFIFO* const fifo, const size_t nbBytes)
+{
+	fifo->Stats.NbGets += nbBytes;
+}
+
+/*! @brief Records old data discarded by the producer in the producer's statistics.
+ *
+ *  @param fifo A pointer to the FIFO.
+ *  @param nbBytes The number of bytes discarded.
+ */
+static inline void StatsDiscard(TFIFO* const fifo, const uint32_t nbBytes)
+{
+	fifo->Stats.NbRejected += nbBytes;
+}
+#else
+#define StatsPut(fifo, requested, accepted, nbBytes) ((void)(requested)) // FIFO_PutN keeps the request only for its statistics
+#define StatsGet(fifo, nbBytes)
+#define StatsDiscard(fifo, nbBytes)
+#endif
 
 
-bool FIFO_Init(TFIFO* const fifo)
+/*! @brief Moves Start on by length bytes from the value the consumer read.
+ *
+ *  With FIFO_POLICY_OVERWRITE the producer may also move Start, so Start is only moved if it has not changed.
+ *  @param fifo A pointer to the FIFO.
+ *  @param start The value of Start that the consumer read.
+ *  @param length The number of bytes to move Start on by.
+ *  @return bool - TRUE if Start was moved, FALSE if the producer discarded the data first.
+ */
+static inline bool AdvanceStart(TFIFO* const fifo, const uint32_t start, const size_t length)
+{
+	if (fifo->Policy != FIFO_POLICY_OVERWRITE)
+	{
+		Atomic_Store(&fifo->Start, start + length);
+		return true;
+	}
+
+	return Atomic_CompareExchange(&fifo->Start, start, start + length);
+}
+
+/*! @brief Discards the oldest data so that there is room for the producer to put length bytes.
+ *
+ *  @param fifo A pointer to a FIFO with FIFO_POLICY_OVERWRITE.
+ *  @param end The value of End that the producer read.
+ *  @param length The number of bytes to make room for - no more than the capacity of the FIFO.
+ */
+static void DiscardOldest(TFIFO* const fifo, const uint32_t end, const size_t length)
+{
+	uint32_t start, excess;
+
+	do
+	{
+		start = Atomic_Load(&fifo->Start);
+
+		// Check if the consumer has already made enough room
+		if ((end - start) + length <= fifo->Mask + 1)
+			return;
+
+		excess = (end - start) + length - (fifo->Mask + 1);
+	} while (!Atomic_CompareExchange(&fifo->Start, start, start + excess));
+
+	StatsDiscard(fifo, excess);
+}
+
+
+bool FIFO_Init(TFIFO* const fifo, const TFIFOPolicy policy)
 {
-	EnterCritical();
 	// Initialise variables to 0
-	fifo->Start = fifo->End = fifo->NbBytes = 0;
+	fifo->Start = fifo->End = 0;
+	fifo->Policy = policy;
+	fifo->Dropping = false;
+
+#if FIFO_STATS
+	memset(&fifo->Stats, 0, sizeof(fifo->Stats));
+#endif
 
-	ExitCritical();
 	return true;
 }
 
 bool FIFO_Put(TFIFO* const fifo, const uint8_t data)
 {
-	EnterCritical();
-	// Check that FIFO buffer isn't full
-	if (fifo->NbBytes == FIFO_SIZE)
+	uint32_t end = fifo->End; // Only the producer writes End, so a local copy is stable
+
+	// Check that FIFO buffer isn't full, or that the rest of a burst isn't being dropped
+	if (fifo->Dropping || ((end - Atomic_Load(&fifo->Start)) > fifo->Mask))
 	{
-		ExitCritical();
-		return false;
+		if (fifo->Policy == FIFO_POLICY_OVERWRITE)
+			DiscardOldest(fifo, end, 1);
+		else
+		{
+			if (fifo->Policy == FIFO_POLICY_DROP_BURST)
+				fifo->Dropping = true;
+
+			StatsPut(fifo, 1, 0, end - fifo->Start);
+			return false;
+		}
 	}
-	else
-	{
-		fifo->Buffer[fifo->End] = data; // write data into buffer
 
-		if (fifo->End == FIFO_SIZE-1) // Check if End is in the buffer's last location. If it is wrap it around to the beginning
-			fifo->End = 0;
-		else
-			fifo->End++; // increment End to the next buffer location
+	fifo->Buffer[end & fifo->Mask] = data; // write data into buffer
 
-		fifo->NbBytes++; // Since we have added a byte to the buffer
+	// The data must be in the buffer before the consumer can see the new End
+	Atomic_Store(&fifo->End, end + 1);
 
-		ExitCritical();
-		return true;
-	}
+	StatsPut(fifo, 1, 1, end + 1 - fifo->Start);
+	return true;
 }
 
 bool FIFO_Get(TFIFO* const fifo, uint8_t* const dataPtr)
 {
-	EnterCritical();
-	// Check that FIFO buffer isn't empty
-	if (fifo->NbBytes == 0)
+	uint32_t start;
+	uint8_t data;
+
+	do
 	{
-		ExitCritical();
-		return false;
-	}
-	else
+		start = fifo->Start; // Only changes under us if the producer discards data
+
+		// Check that FIFO buffer isn't empty - the data is only read after End is seen to move past it
+		if (start == Atomic_Load(&fifo->End))
+			return false;
+
+		data = fifo->Buffer[start & fifo->Mask]; // read the buffer's contents at Start
+
+		// The data has been read before the producer can reuse its location, as AdvanceStart releases it
+	} while (!AdvanceStart(fifo, start, 1));
+
+	*dataPtr = data;
+
+	StatsGet(fifo, 1);
+	return true;
+}
+
+size_t FIFO_PutN(TFIFO* const fifo, const uint8_t* data, size_t length)
+{
+	uint32_t end = fifo->End;
+	size_t requested = length;
+	size_t free, nbBytes, index, first;
+
+	if (fifo->Policy == FIFO_POLICY_OVERWRITE)
 	{
-		*dataPtr = fifo->Buffer[fifo->Start]; // write the buffer's contents at Start into the dataPtr
+		// Only the newest data that fits can be kept
+		if (length > fifo->Mask + 1)
+		{
+			data += length - (fifo->Mask + 1);
+			length = fifo->Mask + 1;
+		}
 
-		if (fifo->Start == FIFO_SIZE-1) // Check if Start is in the buffer's last location. If it is wrap it around to the beginning
-			fifo->Start = 0;
-		else
-			fifo->Start++; // increment End to the next buffer location
+		DiscardOldest(fifo, end, length);
+	}
 
-		fifo->NbBytes--; // Since we have added a byte to the buffer
+	free = fifo->Dropping ? 0 : fifo->Mask + 1 - (end - Atomic_Load(&fifo->Start));
+	nbBytes = (length < free) ? length : free;
+	index = end & fifo->Mask;
+	first = fifo->Mask + 1 - index; // room before the buffer wraps
 
-		ExitCritical();
-		return true;
+	// Drop the rest of the burst once any of it has been rejected
+	if ((nbBytes < length) && (fifo->Policy == FIFO_POLICY_DROP_BURST))
+		fifo->Dropping = true;
+
+	if (nbBytes == 0)
+	{
+		StatsPut(fifo, requested, 0, end - fifo->Start);
+		return 0;
 	}
+
+	if (first > nbBytes)
+		first = nbBytes;
+
+	// Copy up to the end of the buffer, then the remainder to the beginning
+	memcpy(&fifo->Buffer[index], data, first);
+	memcpy(&fifo->Buffer[0], data + first, nbBytes - first);
+
+	Atomic_Store(&fifo->End, end + nbBytes);
+
+	// Bytes cut from the front of an oversized block count as rejected along with any that did not fit
+	StatsPut(fifo, requested, nbBytes, end + nbBytes - fifo->Start);
+	return nbBytes;
+}
+
+size_t FIFO_GetN(TFIFO* const fifo, uint8_t* const dataPtr, const size_t length)
+{
+	uint32_t start;
+	size_t used, nbBytes, index, first;
+
+	do
+	{
+		start = fifo->Start; // Only changes under us if the producer discards data
+		used = Atomic_Load(&fifo->End) - start;
+		nbBytes = (length < used) ? length : used;
+		index = start & fifo->Mask;
+		first = fifo->Mask + 1 - index; // data before the buffer wraps
+
+		if (nbBytes == 0)
+			return 0;
+
+		if (first > nbBytes)
+			first = nbBytes;
+
+		// Copy up to the end of the buffer, then the remainder from the beginning
+		memcpy(dataPtr, &fifo->Buffer[index], first);
+		memcpy(dataPtr + first, &fifo->Buffer[0], nbBytes - first);
+	} while (!AdvanceStart(fifo, start, nbBytes));
+
+	StatsGet(fifo, nbBytes);
+	return nbBytes;
+}
+
+bool FIFO_PeekContiguous(TFIFO* const fifo, const uint8_t** const dataPtr, size_t* const lengthPtr)
+{
+	uint32_t start = fifo->Start;
+	size_t used = Atomic_Load(&fifo->End) - start; // the data is only read after End is seen to move past it
+	size_t index = start & fifo->Mask;
+	size_t first = fifo->Mask + 1 - index; // data before the buffer wraps
+
+	if (used == 0)
+		return false;
+
+	// Remember where the consumer is looking in case the producer discards the data
+	fifo->PeekStart = start;
+
+	*dataPtr = &fifo->Buffer[index];
+	*lengthPtr = (used < first) ? used : first;
+
+	return true;
+}
+
+bool FIFO_Consume(TFIFO* const fifo, const size_t length)
+{
+	// AdvanceStart makes sure the caller has finished with the data before the producer can reuse its location
+	if (!AdvanceStart(fifo, (fifo->Policy == FIFO_POLICY_OVERWRITE) ? fifo->PeekStart : fifo->Start, length))
+		return false;
+
+	StatsGet(fifo, length);
+	return true;
+}
+
+bool FIFO_Reserve(TFIFO* const fifo, uint8_t** const dataPtr, size_t* const lengthPtr)
+{
+	uint32_t end = fifo->End;
+	size_t free = fifo->Mask + 1 - (end - Atomic_Load(&fifo->Start));
+	size_t index = end & fifo->Mask;
+	size_t first = fifo->Mask + 1 - index; // room before the buffer wraps
+
+	if ((free == 0) || fifo->Dropping)
+		return false;
+
+	*dataPtr = &fifo->Buffer[index];
+	*lengthPtr = (free < first) ? free : first;
+
+	return true;
+}
+
+void FIFO_Commit(TFIFO* const fifo, const size_t length)
+{
+	// The data must be in the buffer before the consumer can see the new End
+	Atomic_Store(&fifo->End, fifo->End + length);
+
+	StatsPut(fifo, length, length, fifo->End - fifo->Start);
+}
+
+size_t FIFO_CommitUpTo(TFIFO* const fifo, const size_t index, const bool fullLap)
+{
+	uint32_t end = fifo->End;
+	size_t length = (index - end) & fifo->Mask;
+
+	// Back at the same index is either nothing new or a whole buffer, which only the caller can tell apart
+	if ((length == 0) && fullLap)
+		length = fifo->Mask + 1;
+
+	if (length == 0)
+		return 0;
+
+	// Whatever the hardware wrote over has already gone, so stop the consumer using it
+	if (fifo->Policy == FIFO_POLICY_OVERWRITE)
+		DiscardOldest(fifo, end, length);
+
+	Atomic_Store(&fifo->End, end + length);
+
+	StatsPut(fifo, length, length, end + length - fifo->Start);
+	return length;
+}
+
+void FIFO_EndBurst(TFIFO* const fifo)
+{
+	fifo->Dropping = false;
 }
 
 /* END FIFO */
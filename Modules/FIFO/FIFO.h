@@ -3,6 +3,9 @@
  *  @brief Routines to implement a FIFO buffer.
  *
  *  This contains the structure and "methods" for accessing a byte-wide FIFO.
+ *  The FIFO is a lock-free single-producer/single-consumer ring: exactly one
+ *  context (e.g. an ISR) may put and exactly one other context (e.g. the main
+ *  loop) may get, and no interrupts are masked on either side.
  *
  *  @author PMcL
  *  @date 2015-07-23
@@ -13,30 +16,125 @@
 
 // new types
 #include "Types\types.h"
+#include <stddef.h>
 
-// Number of bytes in a FIFO
-#define FIFO_SIZE 256
+// Set to 1 to keep usage statistics for every FIFO - when 0 the statistics cost no memory or cycles
+#ifndef FIFO_STATS
+#define FIFO_STATS 0
+#endif
+
+#if FIFO_STATS
+/*!
+ * @struct TFIFOStats
+ *
+ *  The producer updates every field except NbGets, which only the consumer updates.
+ */
+typedef struct
+{
+  uint32_t NbPuts;		/*!< The number of bytes put into the FIFO */
+  uint32_t NbGets;		/*!< The number of bytes taken out of the FIFO */
+  uint32_t NbRejected;		/*!< The number of bytes rejected, dropped or overwritten because the FIFO was full */
+  uint32_t PeakNbBytes;		/*!< The largest number of bytes seen in the FIFO */
+  uint32_t NbNearFull;		/*!< The number of bytes offered while the FIFO was within 1/8 of full */
+} TFIFOStats;
+#endif
+
+/*! @brief What a FIFO does with new data when it is full.
+ *
+ */
+typedef enum
+{
+  FIFO_POLICY_REJECT,		/*!< The new data is rejected */
+  FIFO_POLICY_OVERWRITE,	/*!< The oldest data is discarded to make room for the new data */
+  FIFO_POLICY_DROP_BURST	/*!< The new data and the rest of its burst are rejected until FIFO_EndBurst is called */
+} TFIFOPolicy;
 
 /*!
  * @struct TFIFO
+ *
+ *  Start and End are free-running counters which are only ever masked when indexing Buffer.
+ *  Start is only written by the consumer and End is only written by the producer,
+ *  except that with FIFO_POLICY_OVERWRITE the producer also moves Start to discard old data.
+ *  A FIFO should be declared with FIFO_DEFINE so that its capacity is fixed and checked at compile time.
  */
 typedef struct
 {
-  uint16_t Start;		/*!< The index of the position of the oldest data in the FIFO */
-  uint16_t End; 		/*!< The index of the next available empty position in the FIFO */
-  uint16_t volatile NbBytes;	/*!< The number of bytes currently stored in the FIFO */
-  uint8_t Buffer[FIFO_SIZE];	/*!< The actual array of bytes to store the data */
+  uint32_t volatile Start;	/*!< The count of bytes taken out of the FIFO (written by the consumer only) */
+  uint32_t volatile End;	/*!< The count of bytes put into the FIFO (written by the producer only) */
+  uint32_t const Mask;		/*!< The capacity of the FIFO minus 1 */
+  uint8_t* const Buffer;	/*!< The actual array of bytes to store the data */
+  TFIFOPolicy Policy;		/*!< What to do with new data when the FIFO is full */
+  bool volatile Dropping;	/*!< TRUE while the rest of a burst is being dropped (written by the producer only) */
+  uint32_t PeekStart;		/*!< The value of Start when the consumer last peeked (written by the consumer only) */
+#if FIFO_STATS
+  TFIFOStats Stats;		/*!< Usage statistics */
+#endif
 } TFIFO;
 
+/*! @brief Declares a FIFO and its storage with file scope.
+ *
+ *  @param name The name of the TFIFO variable.
+ *  @param size The capacity of the FIFO in bytes - must be a power of 2 of at least 2.
+ */
+#define FIFO_DEFINE(name, size) \
+  _Static_assert(((size) >= 2) && (((size) & ((size) - 1)) == 0), "FIFO " #name " size must be a power of 2"); \
+  static uint8_t name##Buffer[(size)]; \
+  static TFIFO name = { .Start = 0, .End = 0, .Mask = (size) - 1, .Buffer = name##Buffer }
+
+/*! @brief Declares a FIFO whose storage is aligned to its size, for hardware that wraps addresses with a modulo.
+ *
+ *  @param name The name of the TFIFO variable.
+ *  @param size The capacity of the FIFO in bytes - must be a power of 2 of at least 2.
+ */
+#define FIFO_DEFINE_ALIGNED(name, size) \
+  _Static_assert(((size) >= 2) && (((size) & ((size) - 1)) == 0), "FIFO " #name " size must be a power of 2"); \
+  static uint8_t name##Buffer[(size)] __attribute__((aligned(size))); \
+  static TFIFO name = { .Start = 0, .End = 0, .Mask = (size) - 1, .Buffer = name##Buffer }
+
+/*! @brief The number of bytes currently stored in the FIFO.
+ *
+ *  @param fifo A pointer to the FIFO.
+ *  @return uint32_t - the number of bytes in the FIFO.
+ *  @note The result is exact for the caller's end of the FIFO and conservative for the other end.
+ */
+static inline uint32_t FIFO_NbBytes(const TFIFO* const fifo)
+{
+  return fifo->End - fifo->Start;
+}
+
+/*! @brief The free space in the FIFO.
+ *
+ *  @param fifo A pointer to the FIFO.
+ *  @return uint32_t - the number of bytes that can be put into the FIFO.
+ *  @note The result is exact for the caller's end of the FIFO and conservative for the other end.
+ */
+static inline uint32_t FIFO_Space(const TFIFO* const fifo)
+{
+  return fifo->Mask + 1 - (fifo->End - fifo->Start);
+}
+
+/*! @brief The capacity of the FIFO.
+ *
+ *  @param fifo A pointer to the FIFO.
+ *  @return uint32_t - the maximum number of bytes the FIFO can hold.
+ */
+static inline uint32_t FIFO_Capacity(const TFIFO* const fifo)
+{
+  return fifo->Mask + 1;
+}
+
 /*! @brief Initialize the FIFO before first use.
  *
+ *  Empties the FIFO. The buffer and capacity are set up by FIFO_DEFINE.
  *  @param FIFO A pointer to the FIFO that needs initializing.
+ *  @param policy What the FIFO does with new data when it is full.
  *  @return bool - TRUE if the FIFO was successfully initialised
  */
-bool FIFO_Init(TFIFO* const fifo);
+bool FIFO_Init(TFIFO* const fifo, const TFIFOPolicy policy);
 
 /*! @brief Put one character into the FIFO.
  *
+ *  Must only be called from the FIFO's single producer context.
  *  @param FIFO A pointer to a FIFO struct where data is to be stored.
  *  @param data A byte of data to store in the FIFO buffer.
  *  @return bool - TRUE if data is successfully stored in the FIFO.
@@ -46,6 +144,7 @@ bool FIFO_Put(TFIFO* const fifo, const uint8_t data);
 
 /*! @brief Get one character from the FIFO.
  *
+ *  Must only be called from the FIFO's single consumer context.
  *  @param FIFO A pointer to a FIFO struct with data to be retrieved.
  *  @param dataPtr A pointer to a memory location to place the retrieved byte.
  *  @return bool - TRUE if data is successfully retrieved from the FIFO.
@@ -53,4 +152,96 @@ bool FIFO_Put(TFIFO* const fifo, const uint8_t data);
  */
 bool FIFO_Get(TFIFO* const fifo, uint8_t* const dataPtr);
 
+/*! @brief Put a block of characters into the FIFO.
+ *
+ *  As many bytes as there is room for are copied, using at most two block copies.
+ *  With FIFO_POLICY_OVERWRITE the oldest data is discarded instead so that all of the newest data fits;
+ *  a block larger than the FIFO keeps only its last bytes.
+ *  Must only be called from the FIFO's single producer context.
+ *  @param FIFO A pointer to a FIFO struct where data is to be stored.
+ *  @param data A pointer to the bytes to store in the FIFO buffer.
+ *  @param length The number of bytes to store.
+ *  @return size_t - the number of bytes actually stored in the FIFO.
+ *  @note Assumes that FIFO_Init has been called.
+ */
+size_t FIFO_PutN(TFIFO* const fifo, const uint8_t* const data, const size_t length);
+
+/*! @brief Get a block of characters from the FIFO.
+ *
+ *  As many bytes as are available (up to length) are copied, using at most two block copies.
+ *  Must only be called from the FIFO's single consumer context.
+ *  @param FIFO A pointer to a FIFO struct with data to be retrieved.
+ *  @param dataPtr A pointer to a memory location to place the retrieved bytes.
+ *  @param length The maximum number of bytes to retrieve.
+ *  @return size_t - the number of bytes actually retrieved from the FIFO.
+ *  @note Assumes that FIFO_Init has been called.
+ */
+size_t FIFO_GetN(TFIFO* const fifo, uint8_t* const dataPtr, const size_t length);
+
+/*! @brief Find the oldest contiguous block of data in the FIFO without removing it.
+ *
+ *  The block ends either at the newest data or at the end of the buffer, whichever comes first.
+ *  Must only be called from the FIFO's single consumer context.
+ *  @param FIFO A pointer to a FIFO struct with data to be examined.
+ *  @param dataPtr A pointer to a location to place the address of the oldest byte in the FIFO.
+ *  @param lengthPtr A pointer to a location to place the number of contiguous bytes at dataPtr.
+ *  @return bool - TRUE if the FIFO is not empty.
+ *  @note The data remains valid until it is released with FIFO_Consume.
+ */
+bool FIFO_PeekContiguous(TFIFO* const fifo, const uint8_t** const dataPtr, size_t* const lengthPtr);
+
+/*! @brief Remove data from the FIFO that was examined with FIFO_PeekContiguous.
+ *
+ *  Must only be called from the FIFO's single consumer context.
+ *  @param FIFO A pointer to a FIFO struct with data to be removed.
+ *  @param length The number of bytes to remove.
+ *  @return bool - TRUE if the data was removed, FALSE if it was overwritten
+ *                 (FIFO_POLICY_OVERWRITE only) while being examined and must be peeked again.
+ *  @note Assumes that length is no more than the number of bytes in the FIFO.
+ */
+bool FIFO_Consume(TFIFO* const fifo, const size_t length);
+
+/*! @brief Find the contiguous block of free space at the end of the FIFO so it can be written in place.
+ *
+ *  The block ends either at the oldest data or at the end of the buffer, whichever comes first.
+ *  Old data is never overwritten to make room, whatever the FIFO's policy.
+ *  Must only be called from the FIFO's single producer context.
+ *  @param FIFO A pointer to a FIFO struct where data is to be stored.
+ *  @param dataPtr A pointer to a location to place the address of the first free byte in the FIFO.
+ *  @param lengthPtr A pointer to a location to place the number of contiguous free bytes at dataPtr.
+ *  @return bool - TRUE if the FIFO is not full.
+ *  @note Nothing written to the block is visible to the consumer until it is added with FIFO_Commit.
+ */
+bool FIFO_Reserve(TFIFO* const fifo, uint8_t** const dataPtr, size_t* const lengthPtr);
+
+/*! @brief Add data to the FIFO that was written in place after a call to FIFO_Reserve.
+ *
+ *  Must only be called from the FIFO's single producer context.
+ *  @param FIFO A pointer to a FIFO struct where data was stored.
+ *  @param length The number of bytes to add.
+ *  @note Assumes that length is no more than the length returned by FIFO_Reserve.
+ */
+void FIFO_Commit(TFIFO* const fifo, const size_t length);
+
+/*! @brief Add data to the FIFO that was written into the buffer by hardware, such as a circular eDMA transfer.
+ *
+ *  The hardware does not wait for the consumer, so the FIFO should have FIFO_POLICY_OVERWRITE.
+ *  Any old data the hardware has written over is then discarded, and FIFO_Consume tells the consumer if it was reading it.
+ *  Must only be called from the FIFO's single producer context.
+ *  @param FIFO A pointer to a FIFO struct where data was stored.
+ *  @param index The index in the buffer that the hardware will write next.
+ *  @param fullLap TRUE if the hardware has written a whole buffer when index is where the last call left off.
+ *  @return size_t - the number of bytes added.
+ *  @note Must be called at least once per lap of the buffer - the hardware must not write more than the capacity of
+ *        the FIFO between calls, or whole laps are lost.
+ */
+size_t FIFO_CommitUpTo(TFIFO* const fifo, const size_t index, const bool fullLap);
+
+/*! @brief Marks the end of a burst of data so that a FIFO_POLICY_DROP_BURST FIFO accepts data again.
+ *
+ *  Must only be called from the FIFO's single producer context.
+ *  @param FIFO A pointer to a FIFO struct.
+ */
+void FIFO_EndBurst(TFIFO* const fifo);
+
 #endif
@@ -16,11 +16,12 @@
 // new types
 #include "Types\types.h"
 #include "FTM.h"
+#include "Critical\critical.h"
 
 #include "fsl_common.h"
 
 
-static void (*UserFunction)(void *);
+static void (*UserFunction)(void *); // only changed with the FTM interrupt held off, so the ISR reads a matching pair
 static void * UserArguments;
 
 /*! @brief Sets up the FTM before first use.
@@ -37,6 +38,7 @@ bool FTM_Init()
 	FTM0->CNT = ~FTM_CNT_COUNT_MASK; // setting counter to 0 by writing 0x0000 to counter register --> page 988 && 989
 	FTM0->SC = FTM_SC_CLKS(0x02);// Fixed Frequency clock selected as clock source  --> page 988.
 
+	NVIC_SetPriority(FTM0_IRQn, FTM_IRQ_PRIORITY);
 	NVIC_ClearPendingIRQ(FTM0_IRQn); //clearing pending interrupts
 	NVIC_EnableIRQ(FTM0_IRQn); // enable interrupts
 
@@ -61,6 +63,8 @@ bool FTM_Init()
  */
 bool FTM_Set(const TFTMChannel* const aFTMChannel)
 {
+	uint32_t mask;
+
 	if (aFTMChannel->timerFunction == TIMER_FUNCTION_INPUT_CAPTURE)
 	{
 		FTM0->CONTROLS[aFTMChannel->channelNb].CnSC &= ~FTM_CnSC_MSA_MASK;
@@ -95,8 +99,11 @@ bool FTM_Set(const TFTMChannel* const aFTMChannel)
 	}
 
 	//global user function and arguments
+	//changed together with the interrupt held off, so the ISR never pairs a function with the wrong arguments or misses an event
+	mask = Critical_Enter(FTM_IRQ_PRIORITY);
 	UserFunction = aFTMChannel->callbackFunction;
 	UserArguments = aFTMChannel->callbackArguments;
+	Critical_Exit(mask);
 
 	return true;
 }
@@ -134,7 +141,8 @@ void FTM0_IRQHandler(void)
 		if (!(FTM0->CONTROLS[channelNb].CnSC & FTM_CnSC_MSB_MASK) &&
 	 (FTM0->CONTROLS[channelNb].CnSC & FTM_CnSC_MSA_MASK))
 		{
-			(*UserFunction)(UserArguments);
+			if (UserFunction)
+				(*UserFunction)(UserArguments);
 		}
 	}
 }
@@ -14,6 +14,11 @@
 // new types
 #include "Types\types.h"
 
+// Interrupt priority of the FTM - above every critical section ceiling so timer captures are never held off
+#ifndef FTM_IRQ_PRIORITY
+#define FTM_IRQ_PRIORITY 3
+#endif
+
 typedef enum
 {
   TIMER_FUNCTION_INPUT_CAPTURE,
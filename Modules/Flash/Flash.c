@@ -16,6 +16,7 @@
 #include "Flash.h"
 #include "fsl_common.h"
 #include "fsl_port.h"
+#include "Critical\critical.h"
 
 
 #define NB_ADDRESS_REG 3
@@ -127,6 +128,7 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
 {
   static uint8_t memoryAlloc; //memory mask to allocate memory position
   static int variableAddress; //temporary variable address
+  uint32_t mask;
 
   //check the size of the variable
   switch (size)
@@ -143,6 +145,9 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
       break;
   }
 
+  //the allocation map must not change between finding a free location and marking it used
+  mask = Critical_Enter(FLASH_CRITICAL_CEILING);
+
   //loop through the address incrementing by variable size to find an unused memory
   for (variableAddress = FLASH_DATA_START; variableAddress <= FLASH_DATA_END; variableAddress += size)
   {
@@ -153,17 +158,25 @@ bool Flash_AllocateVar(volatile void** variable, const uint8_t size)
       *variable = (void *) variableAddress;
       //change the current memory as used
       FlashMemory = (FlashMemory ^ memoryAlloc);
+      Critical_Exit(mask);
       return true;
     }
     //shift down the memoryAlloc until Flash Memory is empty
     memoryAlloc = memoryAlloc << size; // has >> instead of <<
   }
+
+  Critical_Exit(mask);
   return false;
 }
 
 
 static bool LaunchCommand(FCCOB_t* commonCommandObject)
 {
+	uint32_t mask;
+
+	//the command registers must be loaded and launched as one, but higher priority interrupts can still run
+	mask = Critical_Enter(FLASH_CRITICAL_CEILING);
+
 	//clearing errors
 	FTFE->FSTAT = FTFE_FSTAT_ACCERR_MASK | FTFE_FSTAT_FPVIOL_MASK;
 
@@ -183,6 +196,8 @@ static bool LaunchCommand(FCCOB_t* commonCommandObject)
 
 	FTFE->FSTAT = FTFE_FSTAT_CCIF_MASK; // clear the CCIF to launch the command
 
+	Critical_Exit(mask);
+
 	while(!(FTFE->FSTAT & FTFE_FSTAT_CCIF_MASK)) {}
 
 	return true;
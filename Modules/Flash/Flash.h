@@ -25,6 +25,11 @@
 // Address of the end of the Flash block we are using for data storage
 #define FLASH_DATA_END   0x00080007LU
 
+// Critical section ceiling for Flash bookkeeping - the UART and FTM interrupts have higher priorities and keep running
+#ifndef FLASH_CRITICAL_CEILING
+#define FLASH_CRITICAL_CEILING 4
+#endif
+
 /*! @brief Enables the Flash module.
  *
  *  @return bool - TRUE if the Flash was setup successfully.
@@ -17,10 +17,11 @@
 
 #include "Types\types.h"
 #include "PIT\PIT.h"
+#include "Critical\critical.h"
 
 
 static uint32_t PIT_Clk; 	// module clock.
-static void (*UserFunction)(void *); 	// user call back function.
+static void (*UserFunction)(void *); 	// user call back function - only changed with the PIT interrupt held off.
 static void * UserArguments; 			// user call back function arguments.
 
 
@@ -36,10 +37,15 @@ static void * UserArguments; 			// user call back function arguments.
  */
 bool PIT_Init(const uint32_t moduleClk, void (*userFunction)(void*), void* userArguments)
 {
+	uint32_t mask;
+
 	// values of param global
 	PIT_Clk = moduleClk;
+	// changed together with the interrupt held off, so the ISR never pairs a function with the wrong arguments or misses an event
+	mask = Critical_Enter(PIT_IRQ_PRIORITY);
 	UserFunction = userFunction;
 	UserArguments = userArguments;
+	Critical_Exit(mask);
 
 	// page --> 1117
 	CLOCK_EnableClock(kCLOCK_Pit0); //Clock Enable
@@ -49,6 +55,7 @@ bool PIT_Init(const uint32_t moduleClk, void (*userFunction)(void*), void* userA
 	PIT_Enable(true);
 	//PIT->CHANNEL[0].TCTRL |= PIT_TCTRL_TIE_MASK; // enabling timer interrupts.
 
+	NVIC_SetPriority(PIT0_IRQn, PIT_IRQ_PRIORITY);
 	NVIC_ClearPendingIRQ(PIT0_IRQn); //clearing pending interrupts
 	NVIC_EnableIRQ(PIT0_IRQn); // enable interrupts
 
@@ -14,6 +14,11 @@
 // new types
 #include "Types\types.h"
 
+// Interrupt priority of the PIT
+#ifndef PIT_IRQ_PRIORITY
+#define PIT_IRQ_PRIORITY 5
+#endif
+
 /*! @brief Sets up the PIT before first use.
  *
  *  Enables the PIT and freezes the timer when debugging.
@@ -13,9 +13,15 @@
  *  @date 2020-04-1
  */
 
+#include <string.h>
+
 // New types
 #include "packet.h"
 #include "UART\UART.h"
+#include "Atomic\atomic.h"
+#include "Critical\critical.h"
+#include "Events\Events.h"
+#include "CRC\CRC.h"
 
 
 // Packet structure
@@ -26,92 +32,810 @@
 //		Packet_Parameter3, /*!< The packet's 3rd parameter */
 //		Packet_Checksum;   /*!< The packet's checksum */
 
-static uint8_t currentState = 0; // current state of FSM
+// Number of decoded packets that can wait for the command handlers - must be a power of 2
+#ifndef PACKET_QUEUE_SIZE
+#define PACKET_QUEUE_SIZE 16
+#endif
+
+#if (PACKET_QUEUE_SIZE & (PACKET_QUEUE_SIZE - 1)) != 0
+#error "PACKET_QUEUE_SIZE must be a power of 2"
+#endif
+
+#if PACKET_BURST && ((PACKET_BURST_MAX_PACKETS < 1) || (PACKET_BURST_MAX_PACKETS > 255))
+#error "PACKET_BURST_MAX_PACKETS must fit in parameter 1 of a burst frame header"
+#endif
+
+#if PACKET_SEQUENCED && !PACKET_BURST
+#error "PACKET_SEQUENCED needs PACKET_BURST, since sequenced frames are collected like burst frames"
+#endif
+
+#if PACKET_SEQUENCED && ((PACKET_SEQ_WINDOW & (PACKET_SEQ_WINDOW - 1)) != 0 || (PACKET_SEQ_WINDOW > 16))
+#error "PACKET_SEQ_WINDOW must be a power of 2 no larger than 16"
+#endif
 
+#if PACKET_PAYLOAD && (PACKET_PAYLOAD_MAX_NB_BYTES > 0xFFFF)
+#error "PACKET_PAYLOAD_MAX_NB_BYTES must fit in parameters 2 and 3 of a payload frame header"
+#endif
 
+// Most bytes the Fletcher-16 sums can take in 32 bits before they must be reduced modulo 255
+#define FLETCHER16_BLOCK_NB_BYTES 5802
 
+// Running checksum of a burst or payload frame before any bytes are added
+#if PACKET_FRAME_CRC
+#define FRAME_CHECKSUM_INIT CRC_16_INIT
+#else
+#define FRAME_CHECKSUM_INIT 0
+#endif
 
-bool Packet_Init(const uint32_t moduleClk, const uint32_t baudRate)
+/*!
+ * @struct TPacketContext
+ *
+ *  The parser state and packet queue of one UART.
+ *  The parser only writes QueueEnd and the dispatcher only writes QueueStart.
+ */
+typedef struct
 {
+  TPacket Pending;			/*!< A frame that has not fully arrived, or straddles the end of the receive FIFO */
+  uint8_t NbPendingBytes;		/*!< The number of bytes of a frame already copied into Pending */
+  TPacket Queue[PACKET_QUEUE_SIZE];	/*!< Decoded packets waiting for the command handlers */
+  uint32_t volatile QueueStart;		/*!< The count of packets taken out of the queue */
+  uint32_t volatile QueueEnd;		/*!< The count of packets put into the queue */
+#if PACKET_BURST
+  uint8_t Burst[PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS)];	/*!< A burst frame being collected, starting with its header */
+  uint16_t NbBurstBytes;		/*!< The number of bytes of the burst frame collected so far */
+  uint16_t BurstLength;			/*!< The size of the burst frame being collected, or 0 if there is none */
+  uint8_t BurstNbPackets;		/*!< The number of packets in the last burst frame that was checked */
+  uint8_t BurstNext;			/*!< The next packet of that burst frame to hand out */
+#endif
+#if PACKET_SEQUENCED
+  TPacket SeqWindow[PACKET_SEQ_WINDOW];	/*!< Sequenced packets held until every earlier one has been handed out, by sequence number modulo the window */
+  uint32_t SeqHeld;			/*!< Bit n is set if the packet with sequence number SeqExpected + n is held */
+  uint8_t SeqExpected;			/*!< The sequence number of the next packet to hand out */
+  uint8_t SeqNbUnacked;			/*!< The number of packets handed out since the last acknowledgement */
+  bool SeqAckUrgent;			/*!< The PC has to resend something or has started a new sequence, so needs an acknowledgement now */
+#endif
+} TPacketContext;
+
+static TPacketContext Contexts[UART_NB_PORTS];
 
-	return UART_Init(moduleClk, baudRate);
+TUARTPort Packet_Port;
+
+
+/*! @brief XORs together every byte of a frame, including its checksum.
+ *
+ *  @param frame A pointer to the PACKET_NB_BYTES bytes of the frame.
+ *  @return uint8_t - 0 if the checksum is correct.
+ */
+static inline uint8_t WindowSum(const uint8_t* const frame)
+{
+	return frame[0] ^ frame[1] ^ frame[2] ^ frame[3] ^ frame[4];
 }
 
+#if PACKET_BURST || PACKET_PAYLOAD
+/*! @brief Adds bytes to the running sums of a Fletcher-16 checksum.
+ *
+ *  @param sums The two sums, each reduced modulo 255.
+ *  @param data A pointer to the bytes to add.
+ *  @param length The number of bytes.
+ */
+static void Fletcher16Update(uint32_t sums[2], const uint8_t* data, size_t length)
+{
+	while (length)
+	{
+		size_t block = (length < FLETCHER16_BLOCK_NB_BYTES) ? length : FLETCHER16_BLOCK_NB_BYTES;
 
-bool Packet_Get(void)
+		length -= block;
+
+		// Only reduce the sums once per block, rather than once per byte
+		while (block--)
+		{
+			sums[0] += *data++;
+			sums[1] += sums[0];
+		}
+
+		sums[0] %= 255;
+		sums[1] %= 255;
+	}
+}
+
+/*! @brief Adds bytes to the running checksum of a burst or payload frame.
+ *
+ *  @param checksum FRAME_CHECKSUM_INIT, or the checksum of the bytes preceding data.
+ *  @param data A pointer to the bytes to add.
+ *  @param length The number of bytes.
+ *  @return uint16_t - the checksum of everything up to the end of data.
+ */
+static uint16_t FrameChecksumUpdate(const uint16_t checksum, const uint8_t* const data, const size_t length)
 {
+#if PACKET_FRAME_CRC
+	return CRC_Calculate16(checksum, data, length);
+#else
+	// The Fletcher-16 sums are kept reduced, so they carry over in the two bytes of the checksum
+	uint32_t sums[2] = {checksum & 0xFF, checksum >> 8};
 
-	//Finite State machine here
+	Fletcher16Update(sums, data, length);
+
+	return (uint16_t)((sums[1] << 8) | sums[0]);
+#endif
+}
+
+/*! @brief Checks the checksum at the end of a burst or payload frame.
+ *
+ *  @param frame A pointer to the frame.
+ *  @param length The number of bytes in the frame, including its checksum.
+ *  @return bool - TRUE if the checksum is correct.
+ */
+static bool FrameChecksumValid(const uint8_t* const frame, const size_t length)
+{
+	uint16_t checksum = Packet_FrameChecksum(frame, length - 2);
+
+	return (frame[length - 2] == (checksum & 0xFF)) && (frame[length - 1] == (checksum >> 8));
+}
+#endif
 
-	switch (currentState)
+#if PACKET_BURST
+/*! @brief Checks whether a frame is the header of a burst frame, whose packets follow it.
+ *
+ *  @param header A pointer to a frame whose checksum adds up.
+ *  @return bool - TRUE if the frame is a burst (or sequenced) frame header, announcing header[1] packets.
+ */
+static bool BurstHeader(const uint8_t* const header)
+{
+	if ((header[3] != 0) || (header[1] > PACKET_BURST_MAX_PACKETS))
+		return false;
+
+#if PACKET_SEQUENCED
+	// Parameter 2 of a sequenced frame is the sequence number of its first packet, and it may carry no packets at all
+	if (header[0] == PACKET_SEQ_CMD)
+		return true;
+#endif
+
+	return (header[0] == PACKET_BURST_CMD) && (header[1] != 0) && (header[2] == 0);
+}
+
+/*! @brief Copies one packet out of a burst frame and gives it a valid checksum.
+ *
+ *  @param frame A pointer to the frame.
+ *  @param index The position of the packet in the frame.
+ *  @param packet A pointer to a location to place the packet.
+ */
+static void BurstEntry(const uint8_t* const frame, const uint8_t index, TPacket* const packet)
+{
+	const uint8_t* entry = &frame[PACKET_NB_BYTES + index * PACKET_BURST_ENTRY_NB_BYTES];
+
+	memcpy(packet->bytes, entry, PACKET_BURST_ENTRY_NB_BYTES);
+	packet->packetStruct.checksum = entry[0] ^ entry[1] ^ entry[2] ^ entry[3];
+}
+
+#if PACKET_SEQUENCED
+/*! @brief Takes the packets of a checked sequenced frame into the window, to be handed out in sequence order.
+ *
+ *  @param context The UART's parser state.
+ *  @note The frame checksum must already have been checked, since the frame can start a new sequence.
+ */
+static void SequencedFrame(TPacketContext* const context)
+{
+	uint8_t nbPackets = context->Burst[1];
+	uint8_t sequence = context->Burst[2];
+
+	// A frame with no packets starts a new sequence, dropping anything held from the old one
+	if (nbPackets == 0)
 	{
-	case 0:
-		if (UART_InChar(&Packet_Command)) // true if packet received from RxFIFO
-			currentState = 1; // currentState value will be changed to 1 if true
-		else
-			return false;
-		break;
-	case 1:
-		if (UART_InChar(&Packet_Parameter1))  // true if packet received from RxFIFO
-			currentState = 2; //currentState value will be changed to 2 if true
-		else
-			return false;
-		break;
-	case 2:
-		if (UART_InChar(&Packet_Parameter2))  // true if packet received from RxFIFO
-			currentState  = 3; //currentState value will be changed to 3 if true
-		else
-			return false;
-		break;
-	case 3:
-		if (UART_InChar(&Packet_Parameter3))  // true if packet received from RxFIFO
-			currentState  = 4; //currentState value will be changed to 4 if true
-		else
-			return false;
-		break;
-	case 4:
-		if (UART_InChar(&Packet_Checksum))  // true if packet received from RxFIFO
-			currentState  = 5; //currentState value will be changed to 5 if true
-		else
-			return false;
-		break;
-	case 5:
-		//checking packet validity
-		if ((Packet_Command ^ Packet_Parameter1 ^ Packet_Parameter2 ^ Packet_Parameter3) == Packet_Checksum){
-			currentState = 0;  // packet received is valid, resetting state
-			return true; // packet received
-		}
-		else
+		context->SeqExpected = sequence;
+		context->SeqHeld = 0;
+		context->SeqAckUrgent = true;
+		return;
+	}
+
+	for (uint8_t i = 0; i < nbPackets; i++, sequence++)
+	{
+		uint8_t offset = sequence - context->SeqExpected;
+
+		// Behind the window is a resend whose acknowledgement was lost, and beyond it is more than the PC may have outstanding
+		if (offset >= PACKET_SEQ_WINDOW)
 		{
-			//shift packets
-			Packet_Command = Packet_Parameter1; // Checksum does not add up, right shift bytes
-			Packet_Parameter1 = Packet_Parameter2;
-			Packet_Parameter2 = Packet_Parameter3;
-			Packet_Parameter3 = Packet_Checksum;
-			currentState = 4; // go to state 4 if packet not valid and look for another one
-			return false;
+			context->SeqAckUrgent = true;
+			continue;
 		}
-		break;
 
+		// A packet missing ahead of this one has been lost, so the PC must hear about it without waiting for a timeout
+		if ((context->SeqHeld & ((1U << offset) - 1)) != ((1U << offset) - 1))
+			context->SeqAckUrgent = true;
+
+		BurstEntry(context->Burst, i, &context->SeqWindow[sequence & (PACKET_SEQ_WINDOW - 1)]);
+		context->SeqHeld |= 1U << offset;
 	}
+}
+
+/*! @brief Forgets the sequenced packets held and the acknowledgement owed, keeping the next sequence number expected.
+ *
+ *  @param context The UART's parser state.
+ */
+static void SequencedReset(TPacketContext* const context)
+{
+	context->SeqHeld = 0;
+	context->SeqNbUnacked = 0;
+	context->SeqAckUrgent = false;
+}
+#endif
+
+/*! @brief Hands out the next packet of a checked burst frame, or the next sequenced packet in order.
+ *
+ *  @param context The UART's parser state.
+ *  @param packet A pointer to a location to place the packet.
+ *  @return bool - TRUE if a packet was handed out.
+ */
+static bool BurstHandOut(TPacketContext* const context, TPacket* const packet)
+{
+#if PACKET_SEQUENCED
+	// A sequenced packet is only ready once every earlier one has gone
+	if (context->SeqHeld & 1)
+	{
+		*packet = context->SeqWindow[context->SeqExpected & (PACKET_SEQ_WINDOW - 1)];
+		context->SeqHeld >>= 1;
+		context->SeqExpected++;
+		context->SeqNbUnacked++;
+		return true;
+	}
+#endif
+
+	if (context->BurstNext < context->BurstNbPackets)
+	{
+		BurstEntry(context->Burst, context->BurstNext++, packet);
+		return true;
+	}
+
+	return false;
+}
+
+/*! @brief Copies received data into the burst frame being collected, and checks the frame once it is complete.
+ *
+ *  @param port The UART.
+ *  @param context The UART's parser state.
+ *  @param data A pointer to the oldest received data.
+ *  @param length The number of contiguous bytes at data.
+ *  @return bool - TRUE if the frame is complete, and its packets (if it was good) are ready to be handed out.
+ */
+static bool BurstCollect(const TUARTPort port, TPacketContext* const context, const uint8_t* const data, size_t length)
+{
+	bool valid;
+
+	if (length > (size_t)(context->BurstLength - context->NbBurstBytes))
+		length = context->BurstLength - context->NbBurstBytes;
+
+	memcpy(&context->Burst[context->NbBurstBytes], data, length);
+	if (!UART_RxConsume(port, length))
+		return false; // overwritten while it was being copied, so look again
+
+	context->NbBurstBytes += length;
+	if (context->NbBurstBytes < context->BurstLength)
+		return false;
+
+	// A bad checksum loses the whole burst, since no packet in it can be trusted
+	valid = FrameChecksumValid(context->Burst, context->BurstLength);
+#if PACKET_SEQUENCED
+	if (context->Burst[0] == PACKET_SEQ_CMD)
+	{
+		// Nor can its sequence number, so a damaged frame must not start a new sequence and drop the packets held
+		if (valid)
+			SequencedFrame(context);
+
+		valid = false; // its packets are handed out from the window instead
+	}
+#endif
+	context->BurstNbPackets = valid ? context->Burst[1] : 0;
+	context->BurstNext = 0;
+	context->BurstLength = 0;
+
 	return true;
 }
+#endif
 
+/*! @brief Decides what a frame whose checksum adds up is.
+ *
+ *  @param context The UART's parser state.
+ *  @param frame A pointer to the frame.
+ *  @return bool - TRUE if the frame is a packet, FALSE if it is a burst frame header and collection of the burst has started.
+ */
+static bool FrameDecoded(TPacketContext* const context, const TPacket* const frame)
+{
+#if PACKET_BURST
+	if (BurstHeader(frame->bytes))
+	{
+		memcpy(context->Burst, frame->bytes, PACKET_NB_BYTES);
+		context->NbBurstBytes = PACKET_NB_BYTES;
+		context->BurstLength = PACKET_BURST_NB_BYTES(frame->bytes[1]);
+		return false;
+	}
+#else
+	(void)context;
+	(void)frame;
+#endif
 
-bool Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3)
+	return true;
+}
+
+/*! @brief Attempts to decode one packet from the data received on a UART.
+ *
+ *  @param port The UART.
+ *  @param packet A pointer to a location to place the decoded packet.
+ *  @return bool - TRUE if a valid packet was decoded.
+ */
+static bool Decode(const TUARTPort port, TPacket* const packet)
 {
-		if ((UART_OutChar(command)) &&
-			(UART_OutChar(parameter1)) &&
-			(UART_OutChar(parameter2)) &&
-			(UART_OutChar(parameter3)) &&
-			// value of checksum XORed before sending data
-			(UART_OutChar(command ^ parameter1 ^ parameter2 ^ parameter3 )));
+	TPacketContext* const context = &Contexts[port];
+	const uint8_t* data;
+	size_t length;
+
+#if PACKET_BURST
+	// Hand out the packets of a checked burst frame one at a time
+	if (BurstHandOut(context, packet))
+		return true;
+#endif
+
+	while (UART_RxPeek(port, &data, &length))
+	{
+#if PACKET_BURST
+		if (context->BurstLength)
+		{
+			if (BurstCollect(port, context, data, length) && BurstHandOut(context, packet))
+				return true;
+
+			continue;
+		}
+#endif
+
+		// Fast path: a whole frame lies contiguously in the receive FIFO, so validate it in place
+		if ((context->NbPendingBytes == 0) && (length >= PACKET_NB_BYTES))
+		{
+			size_t skip = 0;
+			uint8_t sum = WindowSum(data);
+
+			// Slide a window along the block until its checksum adds up, updating the sum with the bytes leaving and entering it
+			while ((sum != 0) && (skip + PACKET_NB_BYTES < length))
+			{
+				sum ^= data[skip] ^ data[skip + PACKET_NB_BYTES];
+				skip++;
+			}
+
+			if (sum == 0)
+			{
+				memcpy(packet->bytes, &data[skip], PACKET_NB_BYTES);
+
+				// The frame is only good if it was not overwritten while it was being copied
+				if (UART_RxConsume(port, skip + PACKET_NB_BYTES) && FrameDecoded(context, packet))
+					return true; // packet received
+
+				continue;
+			}
+
+			// No frame starts before the last PACKET_NB_BYTES - 1 bytes of the block, so drop everything ahead of them at once
+			UART_RxConsume(port, skip + 1);
+			continue;
+		}
+
+		// Part of a frame is pending and enough new data has arrived to finish every window that starts in it, so try each
+		// of them in turn, completing them with the new data in place, before dropping back to the fast path
+		if (context->NbPendingBytes && (length >= PACKET_NB_BYTES))
+		{
+			const uint8_t* const pending = context->Pending.bytes;
+			uint8_t nbPending = context->NbPendingBytes, start = 0, sum = 0, nbNew;
+
+			for (uint8_t i = 0; i < nbPending; i++)
+				sum ^= pending[i];
+			for (uint8_t i = 0; i < PACKET_NB_BYTES - nbPending; i++)
+				sum ^= data[i];
+
+			while ((sum != 0) && (++start < nbPending))
+				sum ^= pending[start - 1] ^ data[PACKET_NB_BYTES - nbPending + start - 1];
+
+			context->NbPendingBytes = 0;
+			if (sum == 0)
+			{
+				nbNew = PACKET_NB_BYTES - (nbPending - start);
+				memcpy(packet->bytes, &pending[start], nbPending - start);
+				memcpy(&packet->bytes[nbPending - start], data, nbNew);
+
+				// The frame is only good if the new data was not overwritten while it was being copied
+				if (UART_RxConsume(port, nbNew) && FrameDecoded(context, packet))
+					return true; // packet received
+			}
+
+			continue;
+		}
+
+		// Slow path: the frame straddles the end of the buffer or has not fully arrived
+		if (length > (size_t)(PACKET_NB_BYTES - context->NbPendingBytes))
+			length = PACKET_NB_BYTES - context->NbPendingBytes;
+
+		memcpy(&context->Pending.bytes[context->NbPendingBytes], data, length);
+		if (!UART_RxConsume(port, length))
+			continue; // overwritten while it was being copied, so look again
+
+		context->NbPendingBytes += length;
+
+		if (context->NbPendingBytes == PACKET_NB_BYTES)
 		{
-			return true;
+			if (WindowSum(context->Pending.bytes) == 0)
+			{
+				*packet = context->Pending;
+				context->NbPendingBytes = 0; // packet received is valid, start afresh
+
+				if (FrameDecoded(context, packet))
+					return true; // packet received
+
+				continue;
+			}
+
+			// Checksum does not add up, right shift bytes and look for another one
+			memmove(&context->Pending.bytes[0], &context->Pending.bytes[1], PACKET_NB_BYTES - 1);
+			context->NbPendingBytes = PACKET_NB_BYTES - 1;
 		}
+	}
+
+	return false;
+}
 
+
+#if PACKET_PARSE_IN_ISR
+/*! @brief Decodes packets as data arrives on a UART and wakes the main loop once there are some.
+ *
+ *  @param arguments The UART, cast to a pointer.
+ *  @note Called from the UART receive interrupt.
+ */
+static void ParseCallback(void* arguments)
+{
+	const TUARTPort port = (TUARTPort)(uintptr_t)arguments;
+
+	if (Packet_Parse(port))
+		Events_Set(EVENT_PACKET_RX);
+#if PACKET_SEQUENCED
+	// A resend or a new sequence brings no packets, but the main loop still has to acknowledge it
+	else if (Contexts[port].SeqAckUrgent)
+		Events_Set(EVENT_PACKET_RX);
+#endif
+}
+#endif
+
+
+bool Packet_Init(const TUARTPort port, const uint32_t baudRate)
+{
+	TPacketContext* const context = &Contexts[port];
+
+	context->NbPendingBytes = 0;
+	context->QueueStart = context->QueueEnd = 0;
+#if PACKET_BURST
+	context->BurstLength = 0;
+	context->BurstNbPackets = context->BurstNext = 0;
+#endif
+#if PACKET_SEQUENCED
+	context->SeqExpected = 0;
+	SequencedReset(context);
+#endif
+	Packet_Port = port;
+
+	if (!UART_Init(port, baudRate))
+		return false;
+
+#if PACKET_PARSE_IN_ISR
+	UART_SetRxCallback(port, ParseCallback, (void*)(uintptr_t)port);
+#endif
+
+	return true;
+}
+
+
+uint8_t Packet_Parse(const TUARTPort port)
+{
+	TPacketContext* const context = &Contexts[port];
+	uint8_t nbDecoded = 0;
+	uint32_t end = context->QueueEnd;
+
+	// Decode straight into the queue while there is room
+	while (((end - Atomic_Load(&context->QueueStart)) < PACKET_QUEUE_SIZE) && Decode(port, &context->Queue[end & (PACKET_QUEUE_SIZE - 1)]))
+	{
+		end++;
+		nbDecoded++;
+
+		// The packet must be in the queue before the dispatcher can see the new QueueEnd
+		Atomic_Store(&context->QueueEnd, end);
+	}
+
+	return nbDecoded;
+}
+
+
+void Packet_Flush(const TUARTPort port)
+{
+	TPacketContext* const context = &Contexts[port];
+	const uint8_t* data;
+	size_t length;
+#if PACKET_PARSE_IN_ISR
+	uint32_t mask = Critical_Enter(UART_IRQ_PRIORITY); // the receive interrupt is the parser
+#endif
+
+	while (UART_RxPeek(port, &data, &length))
+		UART_RxConsume(port, length);
+
+	context->NbPendingBytes = 0;
+#if PACKET_BURST
+	context->BurstLength = 0;
+	context->BurstNbPackets = context->BurstNext = 0;
+#endif
+#if PACKET_SEQUENCED
+	SequencedReset(context);
+#endif
+	Atomic_Store(&context->QueueStart, Atomic_Load(&context->QueueEnd));
+
+#if PACKET_PARSE_IN_ISR
+	Critical_Exit(mask);
+#endif
+}
+
+bool Packet_Get(const TUARTPort port)
+{
+	TPacketContext* const context = &Contexts[port];
+	uint32_t start = context->QueueStart;
+	uint32_t end;
+#if PACKET_PARSE_IN_ISR
+	uint32_t mask;
+#else
+	Packet_Parse(port);
+#endif
+
+	end = Atomic_Load(&context->QueueEnd);
+	if (start == end)
+		return false;
+
+	Packet = context->Queue[start & (PACKET_QUEUE_SIZE - 1)];
+	Packet_Port = port;
+
+	// The packet must have been copied before the parser can reuse its location
+	Atomic_Store(&context->QueueStart, start + 1);
+
+#if PACKET_PARSE_IN_ISR
+	// The receive interrupt stops decoding while the queue is full, so decode what it left behind now there is room
+	if ((end - start) == PACKET_QUEUE_SIZE)
+	{
+		mask = Critical_Enter(UART_IRQ_PRIORITY);
+		Packet_Parse(port);
+		Critical_Exit(mask);
+	}
+#endif
+
+	return true;
+}
+
+
+#if PACKET_SEQUENCED
+bool Packet_Acknowledge(const TUARTPort port)
+{
+	TPacketContext* const context = &Contexts[port];
+	bool due;
+	uint8_t expected;
+	uint16_t held;
+#if PACKET_PARSE_IN_ISR
+	uint32_t mask;
+#endif
+
+	// Only the main loop transmits, so once there is room for the acknowledgement it cannot be taken away
+	if (!Packet_CanPut(port, 1))
+		return false;
+
+#if PACKET_PARSE_IN_ISR
+	mask = Critical_Enter(UART_IRQ_PRIORITY); // the receive interrupt is the parser
+#else
+	Packet_Parse(port);
+#endif
+
+	// Batch acknowledgements while the command handlers are busy, but never hold back news of a loss
+	due = context->SeqAckUrgent || (context->SeqNbUnacked >= (PACKET_SEQ_WINDOW + 1) / 2) ||
+	      ((context->SeqNbUnacked != 0) && (context->QueueStart == context->QueueEnd));
+
+	if (due)
+	{
+		expected = context->SeqExpected;
+		held = (uint16_t)(context->SeqHeld >> 1);
+		context->SeqNbUnacked = 0;
+		context->SeqAckUrgent = false;
+	}
+
+#if PACKET_PARSE_IN_ISR
+	Critical_Exit(mask);
+#endif
+
+	if (due)
+	{
+		Packet_Port = port;
+		Packet_Put(PACKET_SEQ_ACK_CMD, expected, held & 0xFF, held >> 8);
+	}
+
+	return true;
+}
+#endif
+
+
+bool Packet_CanPut(const TUARTPort port, const uint8_t nbPackets)
+{
+	return UART_TxAvailable(port, (size_t)nbPackets * PACKET_NB_BYTES);
+}
+
+
+bool Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3)
+{
+	uint8_t* frame;
+	size_t length;
+	uint8_t buffer[PACKET_NB_BYTES];
+
+	// Space only grows while the frame is built, so once the whole frame fits none of it can be rejected
+	if (!UART_TxAvailable(Packet_Port, PACKET_NB_BYTES) || !UART_TxReserve(Packet_Port, &frame, &length))
+		return false;
+
+	// Build the frame straight into the transmit FIFO unless it would straddle the end of the buffer
+
+	if (length < PACKET_NB_BYTES)
+		frame = buffer;
+
+	frame[0] = command;
+	frame[1] = parameter1;
+	frame[2] = parameter2;
+	frame[3] = parameter3;
+	frame[4] = command ^ parameter1 ^ parameter2 ^ parameter3; // value of checksum XORed before sending data
+
+	if (frame == buffer)
+		return (UART_Write(Packet_Port, buffer, PACKET_NB_BYTES) == PACKET_NB_BYTES);
+
+	UART_TxCommit(Packet_Port, PACKET_NB_BYTES);
+	return true;
+}
+
+#if PACKET_BURST || PACKET_PAYLOAD
+uint16_t Packet_Fletcher16(const uint8_t* const data, const size_t length)
+{
+	uint32_t sums[2] = {0, 0};
+
+	Fletcher16Update(sums, data, length);
+
+	return (uint16_t)((sums[1] << 8) | sums[0]);
+}
+
+
+uint16_t Packet_FrameChecksum(const uint8_t* const data, const size_t length)
+{
+	return FrameChecksumUpdate(FRAME_CHECKSUM_INIT, data, length);
+}
+#endif
+
+
+#if PACKET_BURST
+/*! @brief Builds a burst or sequenced frame in a buffer.
+ *
+ *  @param frame A pointer to a buffer of at least PACKET_BURST_NB_BYTES(nbPackets) bytes.
+ *  @param command The command of the frame header.
+ *  @param parameter2 Parameter 2 of the frame header.
+ *  @param packets A pointer to the packets to carry - their checksums are ignored.
+ *  @param nbPackets The number of packets, no more than PACKET_BURST_MAX_PACKETS.
+ *  @return size_t - the number of bytes in the frame.
+ */
+static size_t EncodeBurst(uint8_t* const frame, const uint8_t command, const uint8_t parameter2, const TPacket* const packets, const uint8_t nbPackets)
+{
+	size_t length = PACKET_BURST_NB_BYTES(nbPackets) - PACKET_BURST_CHECKSUM_NB_BYTES;
+	uint16_t checksum;
+
+	frame[0] = command;
+	frame[1] = nbPackets;
+	frame[2] = parameter2;
+	frame[3] = 0;
+	frame[4] = command ^ nbPackets ^ parameter2;
+
+	for (uint8_t i = 0; i < nbPackets; i++)
+		memcpy(&frame[PACKET_NB_BYTES + i * PACKET_BURST_ENTRY_NB_BYTES], packets[i].bytes, PACKET_BURST_ENTRY_NB_BYTES);
+
+	checksum = Packet_FrameChecksum(frame, length);
+	frame[length] = checksum & 0xFF;
+	frame[length + 1] = checksum >> 8;
+
+	return length + PACKET_BURST_CHECKSUM_NB_BYTES;
+}
+
+
+size_t Packet_EncodeBurst(uint8_t* const frame, const TPacket* const packets, const uint8_t nbPackets)
+{
+	if ((nbPackets == 0) || (nbPackets > PACKET_BURST_MAX_PACKETS))
+		return 0;
+
+	return EncodeBurst(frame, PACKET_BURST_CMD, 0, packets, nbPackets);
+}
+
+
+uint8_t Packet_DecodeBurst(const uint8_t* const frame, const size_t length, TPacket* const packets)
+{
+	uint8_t nbPackets;
+
+	if ((length < PACKET_NB_BYTES) || (WindowSum(frame) != 0))
+		return 0;
+
+	if ((frame[0] != PACKET_BURST_CMD) || !BurstHeader(frame))
+		return 0;
+
+	nbPackets = frame[1];
+	if ((length != (size_t)PACKET_BURST_NB_BYTES(nbPackets)) || !FrameChecksumValid(frame, length))
+		return 0;
+
+	for (uint8_t i = 0; i < nbPackets; i++)
+		BurstEntry(frame, i, &packets[i]);
+
+	return nbPackets;
+}
+
+
+bool Packet_PutBurst(const TPacket* const packets, const uint8_t nbPackets)
+{
+	uint8_t frame[PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS)];
+	size_t length = Packet_EncodeBurst(frame, packets, nbPackets);
+
+	return length && UART_TxAvailable(Packet_Port, length) && (UART_Write(Packet_Port, frame, length) == length);
+}
+
+#if PACKET_SEQUENCED
+size_t Packet_EncodeSequenced(uint8_t* const frame, const TPacket* const packets, const uint8_t nbPackets, const uint8_t sequence)
+{
+	if (nbPackets > PACKET_BURST_MAX_PACKETS)
+		return 0;
+
+	return EncodeBurst(frame, PACKET_SEQ_CMD, sequence, packets, nbPackets);
+}
+#endif
+#endif
+
+
+#if PACKET_PAYLOAD
+bool Packet_DecodePayload(const uint8_t* const frame, const size_t length, uint8_t* const commandPtr, const uint8_t** const payloadPtr, uint16_t* const payloadLengthPtr)
+{
+	uint16_t payloadLength;
+
+	if ((length < PACKET_PAYLOAD_NB_BYTES(0)) || (WindowSum(frame) != 0) || (frame[0] != PACKET_PAYLOAD_CMD))
+		return false;
+
+	payloadLength = frame[2] | ((uint16_t)frame[3] << 8);
+	if ((length != (size_t)PACKET_PAYLOAD_NB_BYTES(payloadLength)) || !FrameChecksumValid(frame, length))
 		return false;
+
+	*commandPtr = frame[1];
+	*payloadPtr = &frame[PACKET_NB_BYTES];
+	*payloadLengthPtr = payloadLength;
+
+	return true;
+}
+
+
+bool Packet_PutPayload(const uint8_t command, const uint8_t* const data, const uint16_t length)
+{
+	uint8_t header[PACKET_NB_BYTES], checksum[PACKET_PAYLOAD_CHECKSUM_NB_BYTES];
+	uint16_t running;
+
+	if ((length > PACKET_PAYLOAD_MAX_NB_BYTES) || !UART_TxAvailable(Packet_Port, PACKET_PAYLOAD_NB_BYTES(length)))
+		return false;
+
+	header[0] = PACKET_PAYLOAD_CMD;
+	header[1] = command;
+	header[2] = length & 0xFF;
+	header[3] = length >> 8;
+	header[4] = header[0] ^ header[1] ^ header[2] ^ header[3];
+
+	running = FrameChecksumUpdate(FRAME_CHECKSUM_INIT, header, PACKET_NB_BYTES);
+	running = FrameChecksumUpdate(running, data, length);
+	checksum[0] = running & 0xFF;
+	checksum[1] = running >> 8;
+
+	// There is room for the whole frame, so the payload is sent straight from the caller's buffer without being copied
+	UART_Write(Packet_Port, header, PACKET_NB_BYTES);
+	UART_Write(Packet_Port, data, length);
+	UART_Write(Packet_Port, checksum, PACKET_PAYLOAD_CHECKSUM_NB_BYTES);
+
+	return true;
 }
+#endif
 
 /* END packet */
 /*!
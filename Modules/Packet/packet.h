@@ -13,10 +13,86 @@
 
 // New types
 #include "Types\types.h"
+#include "UART\UART.h"
 
 // Packet structure
 #define PACKET_NB_BYTES 5
 
+// Set to 1 to decode packets in the UART receive interrupt, so the main loop is only woken for complete, valid packets
+#ifndef PACKET_PARSE_IN_ISR
+#define PACKET_PARSE_IN_ISR 0
+#endif
+
+// Set to 1 to end burst and payload frames with a CRC-16/CCITT-FALSE (see CRC.h) instead of a Fletcher-16 checksum.
+// Either way the frame check is 2 bytes, low byte first, and both ends of the link must agree on it.
+#ifndef PACKET_FRAME_CRC
+#define PACKET_FRAME_CRC 0
+#endif
+
+// Set to 1 to accept burst frames alongside 5-byte packets. A burst frame is a 5-byte header packet with command
+// PACKET_BURST_CMD, the number of packets in parameter 1 and parameters 2 and 3 zero, then the command and 3 parameters
+// of each packet without checksums, then a frame checksum of everything before it.
+#ifndef PACKET_BURST
+#define PACKET_BURST 0
+#endif
+
+// Largest number of packets in a burst frame
+#ifndef PACKET_BURST_MAX_PACKETS
+#define PACKET_BURST_MAX_PACKETS 16
+#endif
+
+// The command of a burst frame header, which is never used for a command of its own
+#define PACKET_BURST_CMD 0x7F
+
+// Bytes of each packet in a burst frame, and of the burst frame's checksum
+#define PACKET_BURST_ENTRY_NB_BYTES 4
+#define PACKET_BURST_CHECKSUM_NB_BYTES 2
+
+// The size of a burst frame carrying a number of packets
+#define PACKET_BURST_NB_BYTES(nbPackets) (PACKET_NB_BYTES + (nbPackets) * PACKET_BURST_ENTRY_NB_BYTES + PACKET_BURST_CHECKSUM_NB_BYTES)
+
+// Set to 1 to accept sequenced frames, so the PC can keep up to PACKET_SEQ_WINDOW commands outstanding instead of
+// waiting for each one to be echoed. A sequenced frame is a burst frame with command PACKET_SEQ_CMD and the sequence
+// number of its first packet in parameter 2 - later packets are numbered on from it, modulo 256. Packets are handed out
+// in sequence order and each only once, however often they are resent. The MCU replies with PACKET_SEQ_ACK_CMD packets
+// carrying the next sequence number it expects in parameter 1, so every earlier packet has been accepted, and in
+// parameters 2 (low byte) and 3 a bitmap of packets after it that are already held - bit n for sequence number
+// expected + 1 + n. The PC resends whatever is not acknowledged in time. A sequenced frame with no packets starts a new
+// sequence at its parameter 2, and is acknowledged straight away.
+#ifndef PACKET_SEQUENCED
+#define PACKET_SEQUENCED 0
+#endif
+
+// Most sequenced packets the PC may have outstanding - a power of 2 no larger than the 16 bits of the acknowledgement bitmap
+#ifndef PACKET_SEQ_WINDOW
+#define PACKET_SEQ_WINDOW 8
+#endif
+
+// The command of a sequenced frame header and of an acknowledgement, which are never used for commands of their own
+#define PACKET_SEQ_CMD 0x7D
+#define PACKET_SEQ_ACK_CMD 0x7C
+
+// Set to 1 to send payload frames, which carry a command with a block of data. A payload frame is a 5-byte header packet
+// with command PACKET_PAYLOAD_CMD, the payload's command in parameter 1 and its length in parameters 2 (low byte) and 3,
+// then the payload, then a frame checksum of everything before it.
+#ifndef PACKET_PAYLOAD
+#define PACKET_PAYLOAD 1
+#endif
+
+// Largest payload - a whole payload frame must fit in the UART transmit FIFO
+#ifndef PACKET_PAYLOAD_MAX_NB_BYTES
+#define PACKET_PAYLOAD_MAX_NB_BYTES 240
+#endif
+
+// The command of a payload frame header, which is never used for a command of its own
+#define PACKET_PAYLOAD_CMD 0x7E
+
+// Bytes of a payload frame's checksum
+#define PACKET_PAYLOAD_CHECKSUM_NB_BYTES 2
+
+// The size of a payload frame carrying a number of bytes
+#define PACKET_PAYLOAD_NB_BYTES(length) (PACKET_NB_BYTES + (length) + PACKET_PAYLOAD_CHECKSUM_NB_BYTES)
+
 #pragma pack(push)
 #pragma pack(1)
 
@@ -61,27 +137,159 @@ typedef union
 
 extern TPacket Packet;
 
+// The UART the last packet was received from, which Packet_Put replies on
+extern TUARTPort Packet_Port;
+
 // Acknowledgment bit mask
 extern const uint8_t PACKET_ACK_MASK;
 
-/*! @brief Initializes the packets by calling the initialization routines of the supporting software modules.
+/*! @brief Initializes the packets on a UART by calling the initialization routines of the supporting software modules.
  *
- *  @param moduleClk The module clock rate in Hz.
+ *  Each UART has its own parser and packet queue, so traffic on one never holds up another.
+ *  Packet_Port is set to the UART so that packets can be sent on it straight away.
+ *  @param port The UART to carry the packets.
  *  @param baudRate The desired baud rate in bits/sec.
  *  @return bool - TRUE if the packet module was successfully initialized.
  */
-bool Packet_Init(const uint32_t moduleClk, const uint32_t baudRate);
+bool Packet_Init(const TUARTPort port, const uint32_t baudRate);
+
+/*! @brief Decodes as many packets from the data received on a UART as there is room for in its packet queue.
+ *
+ *  After a bad checksum the parser slides a 5-byte window along the received data to find the next valid frame.
+ *  @param port The UART.
+ *  @return uint8_t - the number of packets decoded.
+ *  @note With PACKET_PARSE_IN_ISR this is called by the UART receive interrupt and must not be called elsewhere.
+ */
+uint8_t Packet_Parse(const TUARTPort port);
+
+/*! @brief Attempts to get a packet from the data received on a UART.
+ *
+ *  Decodes any newly received packets into the packet queue, then takes the oldest one out of the queue.
+ *  With PACKET_PARSE_IN_ISR the packets have already been decoded, so this only takes one out of the queue.
+ *  @param port The UART.
+ *  @return bool - TRUE if a valid packet was placed in Packet, in which case Packet_Port is set to port.
+ */
+bool Packet_Get(const TUARTPort port);
+
+/*! @brief Discards every packet and partial packet received on a UART so far.
+ *
+ *  Used when the received data can no longer be trusted, such as after a baud rate change.
+ *  Sequenced packets that were acknowledged but not yet taken are lost too, so the PC should start a new sequence.
+ *  @param port The UART.
+ */
+void Packet_Flush(const TUARTPort port);
 
-/*! @brief Attempts to get a packet from the received data.
+#if PACKET_SEQUENCED
+/*! @brief Sends an acknowledgement of the sequenced packets received on a UART, if one is due.
  *
- *  @return bool - TRUE if a valid packet was received.
+ *  An acknowledgement is due at once when the PC has to resend something or has started a new sequence,
+ *  and otherwise after every half window of packets or once all of them have been taken by Packet_Get.
+ *  @param port The UART.
+ *  @return bool - TRUE unless the transmit FIFO is too full to send an acknowledgement.
+ *  @note Must only be called from the main loop.
  */
-bool Packet_Get(void);
+bool Packet_Acknowledge(const TUARTPort port);
+#endif
 
-/*! @brief Builds a packet and places it in the transmit FIFO buffer.
+/*! @brief Checks there is room to send a number of packets on a UART without blocking.
  *
- *  @return bool - TRUE if a valid packet was sent.
+ *  If there is not, EVENT_UART_TX is set once the UART's transmit FIFO has emptied.
+ *  @param port The UART.
+ *  @param nbPackets The number of packets to be sent.
+ *  @return bool - TRUE if nbPackets calls to Packet_Put on port will succeed.
+ */
+bool Packet_CanPut(const TUARTPort port, const uint8_t nbPackets);
+
+/*! @brief Builds a packet and places it in the transmit FIFO buffer of Packet_Port.
+ *
+ *  The whole frame is queued or none of it is, so a full transmit FIFO never splits a frame.
+ *  @return bool - TRUE if the packet was queued, FALSE if the transmit FIFO is too full (the send would block).
  */
 bool Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3);
 
+#if PACKET_BURST || PACKET_PAYLOAD
+/*! @brief Calculates a Fletcher-16 checksum, as used to end burst and payload frames unless PACKET_FRAME_CRC is 1.
+ *
+ *  @param data A pointer to the bytes to check.
+ *  @param length The number of bytes.
+ *  @return uint16_t - the checksum, with the second sum in the high byte.
+ */
+uint16_t Packet_Fletcher16(const uint8_t* const data, const size_t length);
+
+/*! @brief Calculates the checksum that ends a burst or payload frame.
+ *
+ *  @param data A pointer to the bytes to check.
+ *  @param length The number of bytes.
+ *  @return uint16_t - the CRC-16 if PACKET_FRAME_CRC is 1, otherwise the Fletcher-16 checksum.
+ */
+uint16_t Packet_FrameChecksum(const uint8_t* const data, const size_t length);
+#endif
+
+#if PACKET_BURST
+
+/*! @brief Builds a burst frame in a buffer.
+ *
+ *  @param frame A pointer to a buffer of at least PACKET_BURST_NB_BYTES(nbPackets) bytes.
+ *  @param packets A pointer to the packets to carry - their checksums are ignored.
+ *  @param nbPackets The number of packets, from 1 to PACKET_BURST_MAX_PACKETS.
+ *  @return size_t - the number of bytes in the frame, or 0 if nbPackets is out of range.
+ */
+size_t Packet_EncodeBurst(uint8_t* const frame, const TPacket* const packets, const uint8_t nbPackets);
+
+/*! @brief Checks a complete burst frame and extracts its packets.
+ *
+ *  @param frame A pointer to the frame, starting with its header packet.
+ *  @param length The number of bytes in the frame.
+ *  @param packets A pointer to space for PACKET_BURST_MAX_PACKETS packets - each is given a valid checksum.
+ *  @return uint8_t - the number of packets extracted, or 0 if the frame is not a valid burst frame.
+ */
+uint8_t Packet_DecodeBurst(const uint8_t* const frame, const size_t length, TPacket* const packets);
+
+/*! @brief Sends several packets as one burst frame on Packet_Port.
+ *
+ *  The whole frame is queued or none of it is.
+ *  @param packets A pointer to the packets to send - their checksums are ignored.
+ *  @param nbPackets The number of packets, from 1 to PACKET_BURST_MAX_PACKETS.
+ *  @return bool - TRUE if the frame was queued, FALSE if nbPackets is out of range or the transmit FIFO is too full.
+ *  @note The receiver must understand burst frames.
+ */
+bool Packet_PutBurst(const TPacket* const packets, const uint8_t nbPackets);
+
+#if PACKET_SEQUENCED
+/*! @brief Builds a sequenced frame in a buffer.
+ *
+ *  @param frame A pointer to a buffer of at least PACKET_BURST_NB_BYTES(nbPackets) bytes.
+ *  @param packets A pointer to the packets to carry - their checksums are ignored.
+ *  @param nbPackets The number of packets, from 0 (to start a new sequence) to PACKET_BURST_MAX_PACKETS.
+ *  @param sequence The sequence number of the first packet.
+ *  @return size_t - the number of bytes in the frame, or 0 if nbPackets is out of range.
+ */
+size_t Packet_EncodeSequenced(uint8_t* const frame, const TPacket* const packets, const uint8_t nbPackets, const uint8_t sequence);
+#endif
+#endif
+
+#if PACKET_PAYLOAD
+/*! @brief Checks a complete payload frame and finds its payload.
+ *
+ *  @param frame A pointer to the frame, starting with its header packet.
+ *  @param length The number of bytes in the frame.
+ *  @param commandPtr A pointer to a location to place the payload's command.
+ *  @param payloadPtr A pointer to a location to place the address of the payload within the frame.
+ *  @param payloadLengthPtr A pointer to a location to place the number of bytes in the payload.
+ *  @return bool - TRUE if the frame is a valid payload frame.
+ */
+bool Packet_DecodePayload(const uint8_t* const frame, const size_t length, uint8_t* const commandPtr, const uint8_t** const payloadPtr, uint16_t* const payloadLengthPtr);
+
+/*! @brief Sends a command with a block of data as one payload frame on Packet_Port.
+ *
+ *  The whole frame is queued or none of it is.
+ *  @param command The payload's command.
+ *  @param data A pointer to the payload.
+ *  @param length The number of bytes in the payload - no more than PACKET_PAYLOAD_MAX_NB_BYTES.
+ *  @return bool - TRUE if the frame was queued, FALSE if the payload is too long or the transmit FIFO is too full.
+ *  @note Payload frames are only sent by the MCU - the parser does not accept them.
+ */
+bool Packet_PutPayload(const uint8_t command, const uint8_t* const data, const uint16_t length);
+#endif
+
 #endif
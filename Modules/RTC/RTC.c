@@ -67,6 +67,7 @@ bool RTC_Init(void (*userFunction)(void*), void* userArguments)
 
 
 
+  NVIC_SetPriority(RTC_Seconds_IRQn, RTC_IRQ_PRIORITY);
   NVIC_ClearPendingIRQ(RTC_Seconds_IRQn);  // Clear pending interrupts on the RTC timer
   NVIC_EnableIRQ(RTC_Seconds_IRQn);  // Enable RTC Interrupt Service Routine
 
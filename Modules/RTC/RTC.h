@@ -14,6 +14,11 @@
 // new types
 #include "Types\types.h"
 
+// Interrupt priority of the RTC seconds interrupt
+#ifndef RTC_IRQ_PRIORITY
+#define RTC_IRQ_PRIORITY 6
+#endif
+
 /*! @brief Initializes the RTC before first use.
  *
  *  Sets up the control register for the RTC and locks it.
@@ -7,7 +7,8 @@
  *
  *  @brief I/O routines for UART communications on the TWR-K70F120M.
  *
- *  This contains the functions for operating the UART (serial port).
+ *  This contains the functions for operating the UARTs (serial ports).
+ *  Each UART has a descriptor with its registers, clocks, pins and FIFOs.
  *
  *  @author Uldis Bagley and Prashant Shrestha
  *  @date 2020-03-18
@@ -15,13 +16,16 @@
 #include "UART.h"
 #include "fsl_common.h"
 #include "FIFO\FIFO.h"
+#include "Events\Events.h"
+#include "Critical\critical.h"
 #include "fsl_port.h"
 
-//Transmitter is driven by baud rate clock divided by 16
-//Receiver has acquisition rate of 16 samples per bit time
-static const uint8_t SAMPLE_BAUD_RATE = 16;
-//Baud Rate Fractional Divisor for baud rate of 38400 with 0.047% error
-static const uint8_t BAUD_RATE_DIVISOR = 32;
+#if (UART_TX_DMA || UART_RX_DMA) && (UART4_ENABLED || UART5_ENABLED)
+#error "UART4 and UART5 share one eDMA request between transmit and receive, so they cannot use eDMA"
+#endif
+
+//Most bytes the transmitter holds outside the transmit FIFO - the 8-byte hardware FIFO of UART0 and UART1 and the shift register
+#define TX_HW_NB_BYTES 9
 
 const port_pin_config_t UART_PORT_PIN_CONFIG =
 {
@@ -35,57 +39,777 @@ const port_pin_config_t UART_PORT_PIN_CONFIG =
 		.lockRegister = kPORT_UnlockRegister
 };
 
-//Globally declared transmit and receive FIFO
-static TFIFO TxFIFO, //Put from packet and Get into UART output by setting TDRE
-             RxFIFO; //When RDRF is set Put and Get from RxFIFO
+//What the transmit and receive FIFOs do with new data when they are full
+#ifndef UART_TX_FIFO_POLICY
+#define UART_TX_FIFO_POLICY FIFO_POLICY_REJECT // FIFO_POLICY_OVERWRITE suits telemetry streams
+#endif
+#ifndef UART_RX_FIFO_POLICY
+#if UART_RX_DMA
+#define UART_RX_FIFO_POLICY FIFO_POLICY_OVERWRITE // the eDMA does not wait for the packet layer
+#else
+#define UART_RX_FIFO_POLICY FIFO_POLICY_DROP_BURST // drop to the end of the burst rather than leave a hole mid-packet
+#endif
+#endif
+
+// Largest major loop count of an eDMA transfer
+#define UART_DMA_MAX_LENGTH 0x7FFFU
+
+#if UART_RX_DMA
+_Static_assert(UART_RX_FIFO_POLICY == FIFO_POLICY_OVERWRITE, "the receive eDMA never waits, so old data is always overwritten");
+_Static_assert(UART_RX_FIFO_SIZE <= UART_DMA_MAX_LENGTH, "the receive FIFO must fit in one eDMA major loop");
+#endif
+#if UART_TX_DMA
+_Static_assert(UART_TX_FIFO_POLICY != FIFO_POLICY_OVERWRITE, "the transmit eDMA reads the transmit FIFO in place, so new data must not overwrite it");
+#endif
+
+//The receive interrupts - with the eDMA a burst of received data is handed on when the line goes idle. Without it the
+//idle line interrupt is only on while a burst may need ending (see RxIRQMask and RxIdleNeeded).
+static const uint8_t RX_IRQ_MASK = UART_C2_RIE_MASK | (UART_RX_DMA ? UART_C2_ILIE_MASK : 0);
+
+//The receive error interrupts - overrun, noise, framing and parity
+static const uint8_t ERROR_IRQ_MASK = UART_C3_ORIE_MASK | UART_C3_NEIE_MASK | UART_C3_FEIE_MASK | UART_C3_PEIE_MASK;
 
+#if UART_FLOW_CONTROL
+_Static_assert(UART_RTS_START_LEVEL < UART_RTS_STOP_LEVEL, "the sender must be restarted below the level it was stopped at");
+#if UART_RX_DMA
+_Static_assert(UART_RTS_STOP_LEVEL <= UART_RX_FIFO_SIZE / 2, "the receive eDMA is only checked every half buffer, so it may fill half the buffer more before it is stopped");
+#else
+_Static_assert(UART_RTS_STOP_LEVEL + 8 <= UART_RX_FIFO_SIZE, "there must be room for the hardware FIFO to be drained once more before reception stops");
+#endif
+#endif
 
-bool UART_Init(const uint32_t moduleClk, const uint32_t baudRate)
+/*!
+ * @struct TUARTDescriptor
+ *
+ *  The constant fields describe the hardware and are fixed at compile time.
+ */
+typedef struct
 {
-	int16union_t sbr; // From types.h
-	float brfd;
+  UART_Type* const Base;		/*!< The UART's registers, or NULL if the UART is not enabled */
+  clock_ip_name_t const Clock;		/*!< The UART's clock gate */
+  clock_name_t const ModuleClock;	/*!< The clock the UART's baud rate is generated from */
+  PORT_Type* const PinPort;		/*!< The port with the UART's pins */
+  clock_ip_name_t const PinPortClock;	/*!< The clock gate of the port with the UART's pins */
+  uint8_t const RxPin;			/*!< The receive pin */
+  uint8_t const TxPin;			/*!< The transmit pin */
+  IRQn_Type const IRQ;			/*!< The UART's receive and transmit interrupt */
+  IRQn_Type const ErrorIRQ;		/*!< The UART's receive error interrupt */
+#if UART_FLOW_CONTROL
+  uint8_t const RtsPin;			/*!< The request to send output, deasserted while the receiver is full */
+  uint8_t const CtsPin;			/*!< The clear to send input, which holds off the transmitter */
+#endif
+  TFIFO* const TxFIFO;			/*!< Put from packet and Get into UART output by setting TDRE */
+  TFIFO* const RxFIFO;			/*!< When RDRF is set Put and Get from RxFIFO */
+#if UART_TX_DMA || UART_RX_DMA
+  uint8_t const TxDMAChannel;		/*!< The eDMA channel for transmission */
+  uint8_t const TxDMASource;		/*!< The eDMA request for transmission */
+  uint8_t const RxDMAChannel;		/*!< The eDMA channel for reception */
+  uint8_t const RxDMASource;		/*!< The eDMA request for reception */
+#endif
+  uint32_t ModuleClk;			/*!< The module clock rate in Hz, kept for baud rate changes */
+  uint32_t BaudRate;			/*!< The baud rate that was requested */
+  int32_t BaudErrorPPM;			/*!< The error of the achieved baud rate in parts per million */
+#if UART_HW_FIFO
+  uint8_t TxHWFIFODepth;		/*!< The number of bytes the transmit hardware FIFO holds */
+#endif
+  bool volatile TxWakeup;		/*!< TRUE while the main loop is waiting for room in the transmit FIFO */
+#if UART_TX_DMA
+  size_t volatile TxDMALength;		/*!< The number of bytes in the transfer the eDMA is working on, 0 when it is idle */
+#endif
+#if UART_FLOW_CONTROL
+  bool volatile RxThrottled;		/*!< TRUE while reception is stopped so the sender is held off */
+#endif
+  void (*RxCallback)(void*);		/*!< Called from the receive interrupt with new data, or NULL to wake the main loop instead */
+  void* RxCallbackArguments;		/*!< The argument passed to RxCallback */
+  TUARTErrorStats ErrorStats;		/*!< The receive errors seen by the UART's error interrupt */
+#if UART_ISR_STATS
+  TUARTISRStats ISRStats;		/*!< The cost of the UART's interrupt */
+#endif
+} TUARTDescriptor;
+
+//Declares the transmit and receive FIFO of a UART
+#if UART_RX_DMA
+#define UART_FIFOS_DEFINE(n) \
+  FIFO_DEFINE(UART##n##TxFIFO, UART_TX_FIFO_SIZE); \
+  FIFO_DEFINE_ALIGNED(UART##n##RxFIFO, UART_RX_FIFO_SIZE) // the eDMA wraps within the buffer using its alignment
+#else
+#define UART_FIFOS_DEFINE(n) \
+  FIFO_DEFINE(UART##n##TxFIFO, UART_TX_FIFO_SIZE); \
+  FIFO_DEFINE(UART##n##RxFIFO, UART_RX_FIFO_SIZE)
+#endif
+
+//The eDMA fields of a UART's descriptor
+#if UART_TX_DMA || UART_RX_DMA
+#define UART_DMA_DESCRIPTOR(n) \
+  .TxDMAChannel = UART##n##_TX_DMA_CHANNEL, .TxDMASource = kDmaRequestMux0UART##n##Tx & 0xFFU, \
+  .RxDMAChannel = UART##n##_RX_DMA_CHANNEL, .RxDMASource = kDmaRequestMux0UART##n##Rx & 0xFFU,
+#else
+#define UART_DMA_DESCRIPTOR(n)
+#endif
+
+//The flow control fields of a UART's descriptor
+#if UART_FLOW_CONTROL
+#define UART_FLOW_DESCRIPTOR(rtsPin, ctsPin) .RtsPin = rtsPin, .CtsPin = ctsPin,
+#else
+#define UART_FLOW_DESCRIPTOR(rtsPin, ctsPin)
+#endif
+
+//The descriptor of a UART with its receive, transmit, RTS and CTS pins on one port
+#define UART_DESCRIPTOR(n, moduleClock, port, rxPin, txPin, rtsPin, ctsPin) \
+  [UART_PORT_##n] = { .Base = UART##n, .Clock = kCLOCK_Uart##n, .ModuleClock = moduleClock, \
+                      .PinPort = PORT##port, .PinPortClock = kCLOCK_Port##port, .RxPin = rxPin, .TxPin = txPin, \
+                      .IRQ = UART##n##_RX_TX_IRQn, .ErrorIRQ = UART##n##_ERR_IRQn, .TxFIFO = &UART##n##TxFIFO, .RxFIFO = &UART##n##RxFIFO, \
+                      UART_DMA_DESCRIPTOR(n) UART_FLOW_DESCRIPTOR(rtsPin, ctsPin) }
+
+#if UART0_ENABLED
+UART_FIFOS_DEFINE(0);
+#endif
+#if UART1_ENABLED
+UART_FIFOS_DEFINE(1);
+#endif
+#if UART2_ENABLED
+UART_FIFOS_DEFINE(2);
+#endif
+#if UART3_ENABLED
+UART_FIFOS_DEFINE(3);
+#endif
+#if UART4_ENABLED
+UART_FIFOS_DEFINE(4);
+#endif
+#if UART5_ENABLED
+UART_FIFOS_DEFINE(5);
+#endif
+
+//UART0 and UART1 run from the core clock and the others from the bus clock (see p. 184 of K64 document)
+//All of a UART's pins are on alternative 3 of the same port (see p. 248 of K64 document)
+static TUARTDescriptor Ports[UART_NB_PORTS] =
+{
+#if UART0_ENABLED
+  UART_DESCRIPTOR(0, kCLOCK_CoreSysClk, B, 16, 17, 2, 3),
+#endif
+#if UART1_ENABLED
+  UART_DESCRIPTOR(1, kCLOCK_CoreSysClk, C, 3, 4, 1, 2),
+#endif
+#if UART2_ENABLED
+  UART_DESCRIPTOR(2, kCLOCK_BusClk, D, 2, 3, 0, 1),
+#endif
+#if UART3_ENABLED
+  UART_DESCRIPTOR(3, kCLOCK_BusClk, C, 16, 17, 18, 19),
+#endif
+#if UART4_ENABLED
+  UART_DESCRIPTOR(4, kCLOCK_BusClk, C, 14, 15, 12, 13),
+#endif
+#if UART5_ENABLED
+  UART_DESCRIPTOR(5, kCLOCK_BusClk, E, 9, 8, 11, 10),
+#endif
+};
+
+
+/*! @brief The receive interrupts a UART starts with.
+ *
+ *  Without the eDMA, a receive watermark above 1 can leave the end of any burst below it, so the idle line interrupt
+ *  stays on to collect it. With a watermark of 1 it is only turned on while the rest of a burst is being dropped.
+ *  @param uart The UART's descriptor.
+ *  @return uint8_t - the receive interrupt enables of C2.
+ */
+static inline uint8_t RxIRQMask(TUARTDescriptor* const uart)
+{
+#if UART_HW_FIFO && !UART_RX_DMA
+	if (uart->Base->RWFIFO > 1)
+		return RX_IRQ_MASK | UART_C2_ILIE_MASK;
+#endif
+
+	(void)uart;
+	return RX_IRQ_MASK;
+}
+
+#if UART_FLOW_CONTROL
+/*! @brief Stops taking bytes from the receiver once the receive FIFO reaches UART_RTS_STOP_LEVEL.
+ *
+ *  The receiver's hardware FIFO then fills to the receive watermark, at which point the UART deasserts RTS.
+ *  @param uart The UART's descriptor.
+ *  @note Called from the UART and eDMA interrupts.
+ */
+static inline void RxThrottle(TUARTDescriptor* const uart)
+{
+	if (FIFO_NbBytes(uart->RxFIFO) < UART_RTS_STOP_LEVEL)
+		return;
+
+	// With RDMAS set RIE also gates the eDMA requests, and clearing IDLE would read a byte the receiver is holding
+	uart->Base->C2 &= ~(RX_IRQ_MASK | UART_C2_ILIE_MASK);
+	uart->RxThrottled = true;
+}
+#endif
+
+/*! @brief Passes newly received data on to the consumer of the receive FIFO.
+ *
+ *  @param uart The UART's descriptor.
+ *  @note Called from the UART and eDMA interrupts.
+ */
+static inline void RxReceived(TUARTDescriptor* const uart)
+{
+	if (uart->RxCallback)
+		(*uart->RxCallback)(uart->RxCallbackArguments);
+	else
+		Events_Set(EVENT_UART_RX); // wake the main loop
+
+#if UART_FLOW_CONTROL
+	RxThrottle(uart);
+#endif
+}
+
+/*! @brief Wakes the main loop if it was waiting for room in the transmit FIFO, which has now emptied.
+ *
+ *  @param uart The UART's descriptor.
+ *  @note Called from the UART and eDMA interrupts.
+ */
+static inline void TxEmptied(TUARTDescriptor* const uart)
+{
+	if (uart->TxWakeup)
+	{
+		uart->TxWakeup = false;
+		Events_Set(EVENT_UART_TX);
+	}
+}
+
+#if UART_TX_DMA || UART_RX_DMA
+/*! @brief Turns on the eDMA and its request multiplexer.
+ */
+static void DMAInit(void)
+{
+	CLOCK_EnableClock(kCLOCK_Dmamux0);
+	CLOCK_EnableClock(kCLOCK_Dma0);
+}
+
+/*! @brief Enables the interrupt of an eDMA channel at the UART's priority, so it never preempts the UART interrupt.
+ *
+ *  @param channel The eDMA channel.
+ */
+static void DMAEnableIRQ(const uint8_t channel)
+{
+	NVIC_SetPriority((IRQn_Type)(DMA0_IRQn + channel), UART_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ((IRQn_Type)(DMA0_IRQn + channel));
+	NVIC_EnableIRQ((IRQn_Type)(DMA0_IRQn + channel));
+}
+#endif
+
+#if UART_RX_DMA
+/*! @brief Adds everything the eDMA has written since the last call to the receive FIFO.
+ *
+ *  The half and full buffer interrupts make sure this is called at least once per lap of the buffer.
+ *  @param uart The UART's descriptor.
+ *  @return bool - TRUE if any data was added.
+ *  @note Called from the UART and eDMA interrupts, which have the same priority so are never nested.
+ */
+static bool RxDMAUpdate(TUARTDescriptor* const uart)
+{
+	uint8_t channel = uart->RxDMAChannel;
+	uint32_t index, crossed;
+
+	// Any error flags held for the eDMA to clear have been cleared by its reads of the data register
+	uart->Base->C3 |= ERROR_IRQ_MASK;
+
+	// The buffer is aligned to its size, so the low bits of the destination address are the index.
+	// A half or full buffer point passed since the last call and no byte arriving while the flag is read and cleared
+	// means the eDMA is back where it was after a whole lap, rather than has written nothing.
+	index = DMA0->TCD[channel].DADDR & (UART_RX_FIFO_SIZE - 1);
+	crossed = DMA0->INT & (1UL << channel);
+	DMA0->CINT = DMA_CINT_CINT(channel);
+	if ((DMA0->TCD[channel].DADDR & (UART_RX_FIFO_SIZE - 1)) != index)
+	{
+		index = DMA0->TCD[channel].DADDR & (UART_RX_FIFO_SIZE - 1);
+		crossed = 0;
+	}
+
+	return (FIFO_CommitUpTo(uart->RxFIFO, index, crossed != 0) != 0);
+}
+
+/*! @brief Sets up an eDMA channel to copy every received byte into the receive FIFO's buffer, wrapping forever.
+ *
+ *  @param uart The UART's descriptor.
+ */
+static void RxDMAInit(TUARTDescriptor* const uart)
+{
+	uint8_t channel = uart->RxDMAChannel;
+
+	DMAMUX->CHCFG[channel] = 0; // the channel must be disabled while it is configured
+
+	// One byte per request from the fixed data register to the buffer, wrapping with a destination modulo
+	DMA0->TCD[channel].SADDR = (uint32_t)&uart->Base->D;
+	DMA0->TCD[channel].SOFF = 0;
+	DMA0->TCD[channel].DADDR = (uint32_t)uart->RxFIFO->Buffer;
+	DMA0->TCD[channel].DOFF = 1;
+	DMA0->TCD[channel].ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0) | DMA_ATTR_DMOD(__builtin_ctz(UART_RX_FIFO_SIZE));
+	DMA0->TCD[channel].NBYTES_MLNO = 1;
+	DMA0->TCD[channel].SLAST = 0;
+	DMA0->TCD[channel].DLAST_SGA = 0; // the modulo has already wrapped the address back to the start
+	DMA0->TCD[channel].CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(UART_RX_FIFO_SIZE);
+	DMA0->TCD[channel].BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(UART_RX_FIFO_SIZE);
+	// Interrupt at each half of the buffer so a burst longer than the buffer is never lapped
+	DMA0->TCD[channel].CSR = DMA_CSR_INTHALF_MASK | DMA_CSR_INTMAJOR_MASK;
+
+	DMAMUX->CHCFG[channel] = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(uart->RxDMASource);
+	DMA0->SERQ = DMA_SERQ_SERQ(channel);
+
+	// With RDMAS set, RDRF raises an eDMA request instead of an interrupt
+	uart->Base->C5 |= UART_C5_RDMAS_MASK;
+
+	DMAEnableIRQ(channel);
+}
+
+/*! @brief Handles the half and full buffer interrupts of a receive eDMA channel.
+ *
+ *  @param uart The UART's descriptor.
+ */
+static void RxDMAHandler(TUARTDescriptor* const uart)
+{
+	// Half of the buffer has been filled without the line going idle - RxDMAUpdate clears the interrupt
+	if (RxDMAUpdate(uart))
+		RxReceived(uart);
+}
+#endif
+
+#if UART_TX_DMA
+/*! @brief Starts an eDMA transfer of the oldest contiguous block in the transmit FIFO if the channel is idle.
+ *
+ *  @param uart The UART's descriptor.
+ *  @note Must be called from the eDMA interrupt or with it masked.
+ */
+static void TxDMAStart(TUARTDescriptor* const uart)
+{
+	uint8_t channel = uart->TxDMAChannel;
+	const uint8_t* data;
+	size_t length;
+
+	if (uart->TxDMALength || !FIFO_PeekContiguous(uart->TxFIFO, &data, &length))
+		return;
+
+	if (length > UART_DMA_MAX_LENGTH)
+		length = UART_DMA_MAX_LENGTH;
+
+	uart->TxDMALength = length;
+	DMA0->TCD[channel].SADDR = (uint32_t)data;
+	DMA0->TCD[channel].CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(length);
+	DMA0->TCD[channel].BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(length);
+	DMA0->SERQ = DMA_SERQ_SERQ(channel);
+}
+
+/*! @brief Sets up an eDMA channel to copy bytes from memory to the UART data register on each transmit request.
+ *
+ *  @param uart The UART's descriptor.
+ */
+static void TxDMAInit(TUARTDescriptor* const uart)
+{
+	uint8_t channel = uart->TxDMAChannel;
+
+	DMAMUX->CHCFG[channel] = 0; // the channel must be disabled while it is configured
+
+	// One byte per request from an incrementing source to the fixed data register
+	DMA0->TCD[channel].DADDR = (uint32_t)&uart->Base->D;
+	DMA0->TCD[channel].SOFF = 1;
+	DMA0->TCD[channel].DOFF = 0;
+	DMA0->TCD[channel].ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);
+	DMA0->TCD[channel].NBYTES_MLNO = 1;
+	DMA0->TCD[channel].SLAST = 0;
+	DMA0->TCD[channel].DLAST_SGA = 0;
+	// Interrupt at the end of the block and stop taking requests until the next block is set up
+	DMA0->TCD[channel].CSR = DMA_CSR_INTMAJOR_MASK | DMA_CSR_DREQ_MASK;
+
+	DMAMUX->CHCFG[channel] = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(uart->TxDMASource);
+
+	uart->TxDMALength = 0;
+
+	// With TDMAS set, TDRE raises an eDMA request instead of an interrupt
+	uart->Base->C5 |= UART_C5_TDMAS_MASK;
+	uart->Base->C2 |= UART_C2_TIE_MASK;
+
+	DMAEnableIRQ(channel);
+}
+
+/*! @brief Handles the transfer complete interrupt of a transmit eDMA channel.
+ *
+ *  @param uart The UART's descriptor.
+ */
+static void TxDMAHandler(TUARTDescriptor* const uart)
+{
+	DMA0->CINT = DMA_CINT_CINT(uart->TxDMAChannel);
+
+	// The block has been written to the UART, so free it and chain to the next one
+	(void)FIFO_Consume(uart->TxFIFO, uart->TxDMALength);
+	uart->TxDMALength = 0;
+	TxDMAStart(uart);
+
+	if (!uart->TxDMALength)
+		TxEmptied(uart);
+}
+#endif
+
+#if UART_FLOW_CONTROL
+/*! @brief Starts taking bytes from the receiver again once the receive FIFO has drained to UART_RTS_START_LEVEL.
+ *
+ *  @param uart The UART's descriptor.
+ *  @note Called by the consumer of the receive FIFO.
+ */
+static void RxUnthrottle(TUARTDescriptor* const uart)
+{
+	uint32_t mask;
+
+	if (!uart->RxThrottled || (FIFO_NbBytes(uart->RxFIFO) > UART_RTS_START_LEVEL))
+		return;
+
+	mask = Critical_Enter(UART_IRQ_PRIORITY);
+	uart->RxThrottled = false;
+#if UART_RX_DMA
+	// Let the eDMA empty the receiver before idle interrupts resume - its reads of the data register clear a stale IDLE
+	uart->Base->C2 |= UART_C2_RIE_MASK;
+	while (uart->Base->S1 & UART_S1_RDRF_MASK);
+
+	// The consumer is already running, so a callback must not be entered again
+	if (RxDMAUpdate(uart) && !uart->RxCallback)
+		Events_Set(EVENT_UART_RX);
+#endif
+	uart->Base->C2 |= RxIRQMask(uart);
+	Critical_Exit(mask);
+}
+#endif
+
+#if UART_HW_FIFO
+/*! @brief Converts a FIFO size field of the PFIFO register to a number of bytes.
+ *
+ *  @param size The TXFIFOSIZE or RXFIFOSIZE field.
+ *  @return uint8_t - the depth of the FIFO.
+ */
+static inline uint8_t HWFIFODepth(const uint8_t size)
+{
+	return size ? (1U << (size + 1)) : 1;
+}
+
+/*! @brief Enables the transmit and receive hardware FIFOs with their watermarks.
+ *
+ *  @param uart The UART's descriptor.
+ *  @note The transmitter and receiver must be disabled.
+ */
+static void HWFIFOInit(TUARTDescriptor* const uart)
+{
+	UART_Type* const base = uart->Base;
+	uint8_t rxDepth = HWFIFODepth((base->PFIFO & UART_PFIFO_RXFIFOSIZE_MASK) >> UART_PFIFO_RXFIFOSIZE_SHIFT);
+
+	uart->TxHWFIFODepth = HWFIFODepth((base->PFIFO & UART_PFIFO_TXFIFOSIZE_MASK) >> UART_PFIFO_TXFIFOSIZE_SHIFT);
+
+	base->PFIFO |= UART_PFIFO_TXFE_MASK | UART_PFIFO_RXFE_MASK;
+	base->CFIFO |= UART_CFIFO_TXFLUSH_MASK | UART_CFIFO_RXFLUSH_MASK;
+
+	// A watermark must leave room in the FIFO for the bytes that arrive while the interrupt is pending
+	base->RWFIFO = (UART_RX_WATERMARK < rxDepth) ? UART_RX_WATERMARK : ((rxDepth > 1) ? rxDepth - 1 : 1);
+	base->TWFIFO = (UART_TX_WATERMARK < uart->TxHWFIFODepth) ? UART_TX_WATERMARK : uart->TxHWFIFODepth - 1;
+}
+#endif
+
+#if !UART_RX_DMA
+/*! @brief Moves received characters from the UART to the receive FIFO.
+ *
+ *  @param uart The UART's descriptor.
+ *  @return uint8_t - the number of characters moved.
+ */
+static inline uint8_t RxDrain(TUARTDescriptor* const uart)
+{
+#if UART_HW_FIFO
+	uint8_t nbBytes = uart->Base->RCFIFO;
+#else
+	uint8_t nbBytes = 1;
+#endif
+
+	for (uint8_t i = 0; i < nbBytes; i++)
+		FIFO_Put(uart->RxFIFO, uart->Base->D);
+
+	return nbBytes;
+}
+
+/*! @brief Checks whether the idle line interrupt is needed to end the current burst of received characters.
+ *
+ *  @param uart The UART's descriptor.
+ *  @return bool - TRUE if characters may be left below the receive watermark, or the receive FIFO is dropping the burst.
+ */
+static inline bool RxIdleNeeded(TUARTDescriptor* const uart)
+{
+#if UART_HW_FIFO
+	if (uart->Base->RWFIFO > 1)
+		return true;
+#endif
+
+	return uart->RxFIFO->Dropping;
+}
+#endif
+
+/*! @brief Clears the IDLE flag, keeping any character already received.
+ *
+ *  A character still waiting in the receiver is read instead, which clears IDLE too. Without the eDMA it goes into the
+ *  receive FIFO; with it, it is left for the eDMA to read.
+ *  @param uart The UART's descriptor.
+ *  @return uint8_t - the number of characters moved to the receive FIFO.
+ *  @note The status register must have been read with IDLE set.
+ */
+static inline uint8_t ClearIdle(TUARTDescriptor* const uart)
+{
+	UART_Type* const base = uart->Base;
+#if UART_HW_FIFO
+	bool waiting = (base->RCFIFO != 0);
+#else
+	bool waiting = ((base->S1 & UART_S1_RDRF_MASK) != 0);
+#endif
+	uint8_t data;
+
+	if (waiting)
+	{
+#if UART_RX_DMA
+		return 0;
+#else
+		return RxDrain(uart);
+#endif
+	}
+
+	data = base->D;
+
+#if UART_HW_FIFO
+	// Reading an empty receive FIFO underflows it, which leaves its pointers misaligned until it is flushed. A character
+	// whose stop bit lands between the read and the flush is flushed with them, but the line has just been idle for a
+	// character time, so that character was already being received when IDLE was read.
+	if (base->SFIFO & UART_SFIFO_RXUF_MASK)
+	{
+		base->CFIFO |= UART_CFIFO_RXFLUSH_MASK;
+		base->SFIFO = UART_SFIFO_RXUF_MASK;
+		return 0;
+	}
+
+#if !UART_RX_DMA
+	// No underflow means a character arrived after RCFIFO was read, and this was it
+	FIFO_Put(uart->RxFIFO, data);
+	return 1;
+#endif
+#endif
+
+	// Without the hardware FIFO a character arriving after S1 was read keeps RDRF set, so it is read again
+	(void)data;
+	return 0;
+}
+
+#if !UART_TX_DMA
+/*! @brief Moves characters from the transmit FIFO to the UART until it is full, and stops transmit interrupts once there are none left.
+ *
+ *  @param uart The UART's descriptor.
+ *  @return uint8_t - the number of characters moved.
+ */
+static inline uint8_t TxFill(TUARTDescriptor* const uart)
+{
+	uint8_t nbBytes = 0;
+#if UART_HW_FIFO
+	uint8_t room = uart->TxHWFIFODepth - uart->Base->TCFIFO;
+#else
+	uint8_t room = 1;
+#endif
+
+	while (nbBytes < room)
+	{
+		if (!FIFO_Get(uart->TxFIFO, (uint8_t *)&uart->Base->D))
+		{
+			uart->Base->C2 &= ~UART_C2_TIE_MASK; // if FIFO_Get returns false disable TIE
+			TxEmptied(uart);
+			break;
+		}
+
+		nbBytes++;
+	}
+
+	return nbBytes;
+}
+#endif
+
+/*! @brief Makes sure data placed in the transmit FIFO will be sent.
+ *
+ *  @param uart The UART's descriptor.
+ */
+static inline void TxStart(TUARTDescriptor* const uart)
+{
+#if UART_TX_DMA
+	uint32_t mask = Critical_Enter(UART_IRQ_PRIORITY);
+
+	TxDMAStart(uart);
+	Critical_Exit(mask);
+#else
+	uart->Base->C2 |= UART_C2_TIE_MASK;
+#endif
+}
+
+
+/*! @brief Loads the baud rate divisor into the UART.
+ *
+ *  @param base The UART's registers.
+ *  @param sbr The 13-bit SBR value.
+ *  @param brfa The 5-bit BRFA value.
+ *  @note The new SBR only takes effect once BDL has been written after BDH.
+ */
+static void SetDivisor(UART_Type* const base, const uint16_t sbr, const uint8_t brfa)
+{
+	base->BDH = (base->BDH & ~UART_BDH_SBR_MASK) | UART_BDH_SBR(sbr >> 8);
+	base->BDL = UART_BDL_SBR(sbr);
+	base->C4 = (base->C4 & ~UART_C4_BRFA_MASK) | UART_C4_BRFA(brfa);
+}
+
+/*! @brief Calculates the baud rate divisor for a UART's module clock and checks it is accurate enough.
+ *
+ *  @param uart The UART's descriptor.
+ *  @param baudRate The desired baud rate in bits/sec.
+ *  @param sbrPtr A pointer to a location to place the 13-bit SBR value.
+ *  @param brfaPtr A pointer to a location to place the 5-bit BRFA value.
+ *  @param errorPPMPtr A pointer to a location to place the error of the achieved baud rate in parts per million.
+ *  @return bool - TRUE if the baud rate can be generated within UART_BAUD_TOLERANCE_PPM.
+ */
+static bool AccurateDivisor(const TUARTDescriptor* const uart, const uint32_t baudRate, uint16_t* const sbrPtr, uint8_t* const brfaPtr, int32_t* const errorPPMPtr)
+{
+	return UART_CalculateDivisor(uart->ModuleClk, baudRate, sbrPtr, brfaPtr, errorPPMPtr) &&
+	       (*errorPPMPtr <= UART_BAUD_TOLERANCE_PPM) && (*errorPPMPtr >= -UART_BAUD_TOLERANCE_PPM);
+}
+
+bool UART_CheckBaudRate(const TUARTPort port, const uint32_t baudRate, int32_t* const errorPPMPtr)
+{
+	uint16_t sbr;
 	uint8_t brfa;
 
-	CLOCK_EnableClock(kCLOCK_Uart0);
-	CLOCK_EnableClock(kCLOCK_PortB); // Enable clock to portB so we can configure it
+	return AccurateDivisor(&Ports[port], baudRate, &sbr, &brfa, errorPPMPtr);
+}
+
+bool UART_SetBaudRate(const TUARTPort port, const uint32_t baudRate)
+{
+	TUARTDescriptor* const uart = &Ports[port];
+	uint16_t sbr;
+	uint8_t brfa;
+	int32_t errorPPM;
+	uint32_t timeout, start;
+
+	if (!AccurateDivisor(uart, baudRate, &sbr, &brfa, &errorPPM))
+		return false;
+
+	// Let everything already queued go out at the old baud rate - 10 bits a byte, plus the hardware FIFO and shift register
+	timeout = (uint64_t)(FIFO_NbBytes(uart->TxFIFO) + TX_HW_NB_BYTES) * 10 * UART_TX_DRAIN_MARGIN *
+	          CLOCK_GetFreq(kCLOCK_CoreSysClk) / uart->BaudRate;
+	start = DWT->CYCCNT;
+
+	while (FIFO_NbBytes(uart->TxFIFO) || !(uart->Base->S1 & UART_S1_TC_MASK))
+	{
+		// Flow control is holding the transmitter up, so leave the baud rate alone
+		if (DWT->CYCCNT - start > timeout)
+			return false;
+	}
+
+	uart->Base->C2 &= ~(UART_C2_RE_MASK | UART_C2_TE_MASK);
+	SetDivisor(uart->Base, sbr, brfa);
+	uart->Base->C2 |= UART_C2_RE_MASK | UART_C2_TE_MASK;
+
+	uart->BaudRate = baudRate;
+	uart->BaudErrorPPM = errorPPM;
 
-	PORT_SetPinConfig(PORTB, 16, &UART_PORT_PIN_CONFIG);
-	PORT_SetPinConfig(PORTB, 17, &UART_PORT_PIN_CONFIG);
+	return true;
+}
 
-	UART0->C2 |= UART_C2_RE_MASK; // Activates the Receiver
-	UART0->C2 |= UART_C2_TE_MASK; // Activates the Transmitter
+void UART_GetBaudRate(const TUARTPort port, uint32_t* const baudRatePtr, int32_t* const errorPPMPtr)
+{
+	*baudRatePtr = Ports[port].BaudRate;
+	*errorPPMPtr = Ports[port].BaudErrorPPM;
+}
+
+bool UART_Init(const TUARTPort port, const uint32_t baudRate)
+{
+	TUARTDescriptor* const uart = &Ports[port];
+	uint16_t sbr;
+	uint8_t brfa;
 
-	UART0->C2 |= UART_C2_RIE_MASK;
+	if ((port >= UART_NB_PORTS) || !uart->Base)
+		return false;
 
 	// SBR and fine adjust calculations
-	sbr.l = moduleClk / (SAMPLE_BAUD_RATE * baudRate); // Fills union address with sbr value (whole number)
+	uart->ModuleClk = CLOCK_GetFreq(uart->ModuleClock);
+	if (!UART_CalculateDivisor(uart->ModuleClk, baudRate, &sbr, &brfa, &uart->BaudErrorPPM))
+		return false;
+
+	uart->BaudRate = baudRate;
+
+	CLOCK_EnableClock(uart->Clock);
+	CLOCK_EnableClock(uart->PinPortClock); // Enable clock to the pins' port so we can configure it
+
+	PORT_SetPinConfig(uart->PinPort, uart->RxPin, &UART_PORT_PIN_CONFIG);
+	PORT_SetPinConfig(uart->PinPort, uart->TxPin, &UART_PORT_PIN_CONFIG);
+
+#if UART_FLOW_CONTROL
+	PORT_SetPinConfig(uart->PinPort, uart->RtsPin, &UART_PORT_PIN_CONFIG);
+	PORT_SetPinConfig(uart->PinPort, uart->CtsPin, &UART_PORT_PIN_CONFIG);
 
-	brfd = ((moduleClk / ((float)SAMPLE_BAUD_RATE * baudRate)) - (SAMPLE_BAUD_RATE * sbr.l));
-	brfa = brfd * BAUD_RATE_DIVISOR;
+	// The transmitter waits for CTS, and RTS is deasserted while the receiver holds at least the receive watermark
+	uart->Base->MODEM = UART_MODEM_TXCTSE_MASK | UART_MODEM_RXRTSE_MASK;
+	uart->RxThrottled = false;
+#endif
 
-	// Set SBR registers
-	UART0->BDH |= UART_BDH_SBR(sbr.s.Hi);
-	UART0->BDL |= UART_BDL_SBR(sbr.s.Lo);
+#if UART_HW_FIFO
+	HWFIFOInit(uart); // the FIFOs can only be configured while the transmitter and receiver are off
+#endif
 
-	//Set BRFD
-	UART0->C4 |= UART_C4_BRFA(brfa);
+	// Set SBR registers and BRFA
+	SetDivisor(uart->Base, sbr, brfa);
+
+	uart->Base->C2 |= UART_C2_RE_MASK; // Activates the Receiver
+	uart->Base->C2 |= UART_C2_TE_MASK; // Activates the Transmitter
+
+	uart->Base->C2 |= UART_C2_RIE_MASK;
 
 	//Initialise TxFIFO and RxFIFO
-	FIFO_Init(&TxFIFO);
-	FIFO_Init(&RxFIFO);
+	FIFO_Init(uart->TxFIFO, UART_TX_FIFO_POLICY);
+	FIFO_Init(uart->RxFIFO, UART_RX_FIFO_POLICY);
+
+#if UART_TX_DMA || UART_RX_DMA
+	DMAInit();
+#endif
+#if UART_TX_DMA
+	TxDMAInit(uart);
+#endif
+#if UART_RX_DMA
+	RxDMAInit(uart);
+#endif
+
+	uart->Base->C2 |= RxIRQMask(uart); // Enables the idle line interrupt if it is used
+	uart->Base->C3 |= ERROR_IRQ_MASK; // Without them an overrun goes unnoticed and holds up the receiver
 
-	NVIC_ClearPendingIRQ(UART0_RX_TX_IRQn);  // Clear pending interrupts on the UART
-	NVIC_EnableIRQ(UART0_RX_TX_IRQn); // Enable interrupts
+	NVIC_SetPriority(uart->IRQ, UART_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(uart->IRQ);  // Clear pending interrupts on the UART
+	NVIC_EnableIRQ(uart->IRQ); // Enable interrupts
+
+	// The error interrupt runs at the same priority so it never preempts the receive interrupt
+	NVIC_SetPriority(uart->ErrorIRQ, UART_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(uart->ErrorIRQ);
+	NVIC_EnableIRQ(uart->ErrorIRQ);
 
 	return true;
 }
 
-bool UART_InChar(uint8_t* const dataPtr)
+void UART_SetRxCallback(const TUARTPort port, void (*userFunction)(void*), void* userArguments)
 {
-	return FIFO_Get(&RxFIFO, dataPtr);
+	uint32_t mask = Critical_Enter(UART_IRQ_PRIORITY);
+
+	Ports[port].RxCallback = userFunction;
+	Ports[port].RxCallbackArguments = userArguments;
+	Critical_Exit(mask);
 }
 
-bool UART_OutChar(const uint8_t data)
+bool UART_InChar(const TUARTPort port, uint8_t* const dataPtr)
+{
+	bool success = FIFO_Get(Ports[port].RxFIFO, dataPtr);
+
+#if UART_FLOW_CONTROL
+	RxUnthrottle(&Ports[port]);
+#endif
+
+	return success;
+}
+
+bool UART_OutChar(const TUARTPort port, const uint8_t data)
 {
 	/*if (FIFO_Put(&TxFIFO, data))
 	{
@@ -104,42 +828,262 @@ bool UART_OutChar(const uint8_t data)
 	}
 	else
 		return false;*/
-	bool success = FIFO_Put(&TxFIFO, data);
+	bool success = FIFO_Put(Ports[port].TxFIFO, data);
 
   if (success)
   {
-		UART0->C2 |= UART_C2_TIE_MASK;
+		TxStart(&Ports[port]);
   }
 
 	 return success;
 }
 
-void UART0_RX_TX_DriverIRQHandler(void)
+size_t UART_Write(const TUARTPort port, const uint8_t* const data, const size_t length)
 {
-	bool success;
-	// Receive a character
-	if (UART0->C2 & UART_C2_RIE_MASK)
-	{
-		// Clear RDRF flag by reading the status register
-		if (UART0->S1 & UART_S1_RDRF_MASK)
-			FIFO_Put(&RxFIFO, UART0->D);
-	}
+	size_t nbBytes = FIFO_PutN(Ports[port].TxFIFO, data, length);
 
+	if (nbBytes)
+		TxStart(&Ports[port]);
 
-	// Transmit a character
-	if (UART0->C2 & UART_C2_TIE_MASK)
+	return nbBytes;
+}
+
+size_t UART_Read(const TUARTPort port, uint8_t* const dataPtr, const size_t length)
+{
+	size_t nbBytes = FIFO_GetN(Ports[port].RxFIFO, dataPtr, length);
+
+#if UART_FLOW_CONTROL
+	RxUnthrottle(&Ports[port]);
+#endif
+
+	return nbBytes;
+}
+
+bool UART_RxPeek(const TUARTPort port, const uint8_t** const dataPtr, size_t* const lengthPtr)
+{
+	return FIFO_PeekContiguous(Ports[port].RxFIFO, dataPtr, lengthPtr);
+}
+
+bool UART_RxConsume(const TUARTPort port, const size_t length)
+{
+	bool success = FIFO_Consume(Ports[port].RxFIFO, length);
+
+#if UART_FLOW_CONTROL
+	RxUnthrottle(&Ports[port]);
+#endif
+
+	return success;
+}
+
+bool UART_TxAvailable(const TUARTPort port, const size_t length)
+{
+	TUARTDescriptor* const uart = &Ports[port];
+
+	if (FIFO_Space(uart->TxFIFO) >= length)
+		return true;
+
+	// Ask to be woken once the transmitter has caught up, then look again in case it already has
+	uart->TxWakeup = true;
+	if (FIFO_Space(uart->TxFIFO) < length)
+		return false;
+
+	// No longer waiting, so the transmit interrupt must not set EVENT_UART_TX for a wait that has ended
+	uart->TxWakeup = false;
+	return true;
+}
+
+bool UART_TxReserve(const TUARTPort port, uint8_t** const dataPtr, size_t* const lengthPtr)
+{
+	return FIFO_Reserve(Ports[port].TxFIFO, dataPtr, lengthPtr);
+}
+
+void UART_TxCommit(const TUARTPort port, const size_t length)
+{
+	FIFO_Commit(Ports[port].TxFIFO, length);
+
+	if (length)
+		TxStart(&Ports[port]);
+}
+
+#if FIFO_STATS
+void UART_GetFIFOStats(const TUARTPort port, TFIFOStats* const rxStats, TFIFOStats* const txStats)
+{
+	*rxStats = Ports[port].RxFIFO->Stats;
+	*txStats = Ports[port].TxFIFO->Stats;
+}
+#endif
+
+void UART_GetErrorStats(const TUARTPort port, TUARTErrorStats* const stats)
+{
+	uint32_t mask = Critical_Enter(UART_IRQ_PRIORITY);
+
+	*stats = Ports[port].ErrorStats;
+	Critical_Exit(mask);
+}
+
+#if UART_ISR_STATS
+void UART_GetISRStats(const TUARTPort port, TUARTISRStats* const stats)
+{
+	uint32_t mask = Critical_Enter(UART_IRQ_PRIORITY);
+
+	*stats = Ports[port].ISRStats;
+	Critical_Exit(mask);
+}
+#endif
+
+/*! @brief Services the receive and transmit interrupt of a UART.
+ *
+ *  @param uart The UART's descriptor.
+ */
+static void IRQHandler(TUARTDescriptor* const uart)
+{
+	UART_Type* const base = uart->Base;
+#if UART_ISR_STATS
+	uint32_t entry = DWT->CYCCNT;
+#endif
+	uint8_t nbBytes = 0;
+	uint8_t status = base->S1; // Reading the status register is the first step in clearing RDRF and IDLE
+
+#if UART_RX_DMA
+	// The line has gone idle so hand the burst the eDMA has received to the packet layer
+	if ((base->C2 & UART_C2_ILIE_MASK) && (status & UART_S1_IDLE_MASK))
 	{
-		// Clear TDRE flag by reading the status register
-		if (UART0->S1 & UART_S1_TDRE_MASK)
+		// Clear IDLE flag by reading the data register, unless the eDMA has a character still to read
+		ClearIdle(uart);
+
+		if (RxDMAUpdate(uart))
+			RxReceived(uart);
+	}
+#else
+	// Receive characters
+	if (base->C2 & UART_C2_RIE_MASK)
+	{
+		// Clear RDRF flag by reading the data register until the hardware FIFO is below its watermark
+		if (status & UART_S1_RDRF_MASK)
 		{
-			success = FIFO_Get(&TxFIFO, (uint8_t *)&UART0->D);
-			if (!success) // Gets data from TxFIFO if hardware is ready to transmit a packet
-				UART0->C2 &= ~UART_C2_TIE_MASK; // if FIFO_Get returns false disable TIE
+			nbBytes += RxDrain(uart);
+
+			// Have the end of the burst signalled if it is needed
+			if (RxIdleNeeded(uart))
+				base->C2 |= UART_C2_ILIE_MASK;
+
+			// An IDLE read above only marked a gap before these characters, and reading them cleared it,
+			// so look again - the line has only gone idle after them if IDLE is set once more
+			status = base->S1;
 		}
 	}
 
+	// The line has gone idle so the burst of received characters has ended
+	if ((base->C2 & UART_C2_ILIE_MASK) && (status & UART_S1_IDLE_MASK))
+	{
+		// Collect the end of the burst left below the receive watermark, which clears IDLE, or clear IDLE on its own
+		nbBytes += ClearIdle(uart);
+
+		FIFO_EndBurst(uart->RxFIFO);
+
+		// Leave it on if the next burst may end below the receive watermark
+		if (!RxIdleNeeded(uart))
+			base->C2 &= ~UART_C2_ILIE_MASK;
+	}
+
+	if (nbBytes)
+		RxReceived(uart);
+#endif
+
+#if !UART_TX_DMA
+	// Transmit characters
+	if (base->C2 & UART_C2_TIE_MASK)
+	{
+		// Clear TDRE flag by writing the data register until the hardware FIFO is full
+		if (base->S1 & UART_S1_TDRE_MASK)
+			nbBytes += TxFill(uart);
+	}
+#endif
+
+#if UART_ISR_STATS
+	uart->ISRStats.NbInterrupts++;
+	uart->ISRStats.NbBytes += nbBytes;
+	uart->ISRStats.Cycles += DWT->CYCCNT - entry;
+#endif
+}
+
+/*! @brief Counts and clears the receive errors of a UART.
+ *
+ *  @param uart The UART's descriptor.
+ */
+static void ErrorHandler(TUARTDescriptor* const uart)
+{
+	UART_Type* const base = uart->Base;
+	uint8_t status = base->S1; // Reading the status register is the first step in clearing the error flags
+
+	// The receive interrupt may have read the data register since the error was raised, which clears the flags
+	if (!(status & (UART_S1_OR_MASK | UART_S1_NF_MASK | UART_S1_FE_MASK | UART_S1_PF_MASK)))
+		return;
+
+	if (status & UART_S1_OR_MASK)
+		uart->ErrorStats.NbOverruns++;
+	if (status & UART_S1_NF_MASK)
+		uart->ErrorStats.NbNoise++;
+	if (status & UART_S1_FE_MASK)
+		uart->ErrorStats.NbFraming++;
+	if (status & UART_S1_PF_MASK)
+		uart->ErrorStats.NbParity++;
+
+#if UART_RX_DMA
+	// Reading the data register would take a character from the eDMA, so leave its next read to clear the flags
+	if (status & UART_S1_RDRF_MASK)
+		base->C3 &= ~ERROR_IRQ_MASK; // RxDMAUpdate enables them again
+	else
+		ClearIdle(uart);
+#else
+	// Clear the flags by reading the data register, keeping the characters received so far
+	if (ClearIdle(uart))
+		RxReceived(uart);
+#endif
 }
 
+// Builds the name of the transfer complete handler of an eDMA channel
+#define UART_DMA_HANDLER(channel) UART_DMA_HANDLER_NAME(channel)
+#define UART_DMA_HANDLER_NAME(channel) DMA##channel##_DriverIRQHandler
+
+//The eDMA interrupt handlers of a UART
+#if UART_TX_DMA
+#define UART_TX_DMA_HANDLER(n) void UART_DMA_HANDLER(UART##n##_TX_DMA_CHANNEL)(void) { TxDMAHandler(&Ports[UART_PORT_##n]); }
+#else
+#define UART_TX_DMA_HANDLER(n)
+#endif
+#if UART_RX_DMA
+#define UART_RX_DMA_HANDLER(n) void UART_DMA_HANDLER(UART##n##_RX_DMA_CHANNEL)(void) { RxDMAHandler(&Ports[UART_PORT_##n]); }
+#else
+#define UART_RX_DMA_HANDLER(n)
+#endif
+
+//The interrupt handlers of a UART
+#define UART_HANDLERS(n) \
+  void UART##n##_RX_TX_DriverIRQHandler(void) { IRQHandler(&Ports[UART_PORT_##n]); } \
+  void UART##n##_ERR_DriverIRQHandler(void) { ErrorHandler(&Ports[UART_PORT_##n]); } \
+  UART_TX_DMA_HANDLER(n) \
+  UART_RX_DMA_HANDLER(n)
+
+#if UART0_ENABLED
+UART_HANDLERS(0)
+#endif
+#if UART1_ENABLED
+UART_HANDLERS(1)
+#endif
+#if UART2_ENABLED
+UART_HANDLERS(2)
+#endif
+#if UART3_ENABLED
+UART_HANDLERS(3)
+#endif
+#if UART4_ENABLED
+UART_HANDLERS(4)
+#endif
+#if UART5_ENABLED
+UART_HANDLERS(5)
+#endif
+
 /* END UART */
 /*!
 ** @}
@@ -13,36 +13,342 @@
 
 // new types
 #include "Types\types.h"
+#include <stddef.h>
+#include "FIFO\FIFO.h"
 
-/*! @brief Sets up the UART interface before first use.
+// Largest baud rate error accepted by UART_SetBaudRate, in parts per million
+#ifndef UART_BAUD_TOLERANCE_PPM
+#define UART_BAUD_TOLERANCE_PPM 20000
+#endif
+
+// How long UART_SetBaudRate waits for queued bytes to be sent, as a multiple of the time they take at the old baud rate.
+// With flow control the PC can hold the transmitter up for as long as it likes.
+#ifndef UART_TX_DRAIN_MARGIN
+#define UART_TX_DRAIN_MARGIN 2
+#endif
+
+// Interrupt priority of the UART - above FLASH_CRITICAL_CEILING and the other modules' interrupts, so they never hold off
+// reception. Critical sections with a ceiling of UART_IRQ_PRIORITY or higher do: the UART's and packet layer's own
+// short FIFO and parser bookkeeping.
+#ifndef UART_IRQ_PRIORITY
+#define UART_IRQ_PRIORITY 2
+#endif
+
+/*! @brief The UARTs of the K64.
  *
- *  @param moduleClk The module clock rate in Hz.
+ */
+typedef enum
+{
+  UART_PORT_0,
+  UART_PORT_1,
+  UART_PORT_2,
+  UART_PORT_3,
+  UART_PORT_4,
+  UART_PORT_5,
+  UART_NB_PORTS
+} TUARTPort;
+
+// Set to 1 for each UART in use - each one costs its transmit and receive FIFOs
+#ifndef UART0_ENABLED
+#define UART0_ENABLED 1
+#endif
+#ifndef UART1_ENABLED
+#define UART1_ENABLED 0
+#endif
+#ifndef UART2_ENABLED
+#define UART2_ENABLED 0
+#endif
+#ifndef UART3_ENABLED
+#define UART3_ENABLED 0
+#endif
+#ifndef UART4_ENABLED
+#define UART4_ENABLED 0
+#endif
+#ifndef UART5_ENABLED
+#define UART5_ENABLED 0
+#endif
+
+// Set to 1 to move transmitted data from the transmit FIFO to the UART with eDMA instead of one interrupt per byte
+#ifndef UART_TX_DMA
+#define UART_TX_DMA 0
+#endif
+
+// Set to 1 to receive with eDMA into a circular buffer, with an interrupt per burst instead of one per byte
+#ifndef UART_RX_DMA
+#define UART_RX_DMA 0
+#endif
+
+// eDMA channels used by each UART - the channels' interrupts run at UART_IRQ_PRIORITY
+// UART4 and UART5 share one eDMA request between transmit and receive, so they cannot use eDMA
+#ifndef UART0_TX_DMA_CHANNEL
+#define UART0_TX_DMA_CHANNEL 0
+#endif
+#ifndef UART0_RX_DMA_CHANNEL
+#define UART0_RX_DMA_CHANNEL 1
+#endif
+#ifndef UART1_TX_DMA_CHANNEL
+#define UART1_TX_DMA_CHANNEL 2
+#endif
+#ifndef UART1_RX_DMA_CHANNEL
+#define UART1_RX_DMA_CHANNEL 3
+#endif
+#ifndef UART2_TX_DMA_CHANNEL
+#define UART2_TX_DMA_CHANNEL 4
+#endif
+#ifndef UART2_RX_DMA_CHANNEL
+#define UART2_RX_DMA_CHANNEL 5
+#endif
+#ifndef UART3_TX_DMA_CHANNEL
+#define UART3_TX_DMA_CHANNEL 6
+#endif
+#ifndef UART3_RX_DMA_CHANNEL
+#define UART3_RX_DMA_CHANNEL 7
+#endif
+
+// Set to 1 to use the UARTs' hardware FIFOs so each interrupt moves several bytes - only UART0 and UART1 have more than 1 byte
+#ifndef UART_HW_FIFO
+#define UART_HW_FIFO 1
+#endif
+
+// Number of received bytes in the hardware FIFO that raises an interrupt - bytes below it are collected when the line goes idle
+#ifndef UART_RX_WATERMARK
+#if UART_RX_DMA
+#define UART_RX_WATERMARK 1 // the eDMA moves one byte per request
+#else
+#define UART_RX_WATERMARK 4
+#endif
+#endif
+
+// Number of bytes left in the hardware FIFO that raises a transmit interrupt
+#ifndef UART_TX_WATERMARK
+#define UART_TX_WATERMARK 2
+#endif
+
+// Set to 1 for RTS/CTS hardware flow control, so the sender is held off while the receive FIFO is nearly full
+// instead of received bytes being lost while the main loop is blocked, for example by a flash erase
+#ifndef UART_FLOW_CONTROL
+#define UART_FLOW_CONTROL 0
+#endif
+
+// Capacity of the transmit and receive FIFOs - each must be a power of 2
+#ifndef UART_TX_FIFO_SIZE
+#define UART_TX_FIFO_SIZE 256
+#endif
+#ifndef UART_RX_FIFO_SIZE
+#define UART_RX_FIFO_SIZE 1024 // deep enough to absorb bursts at high baud rates
+#endif
+
+// Number of bytes in the receive FIFO at which the sender is stopped, and the number it must drain to before the sender is restarted
+#ifndef UART_RTS_STOP_LEVEL
+#define UART_RTS_STOP_LEVEL (UART_RX_FIFO_SIZE / 2)
+#endif
+#ifndef UART_RTS_START_LEVEL
+#define UART_RTS_START_LEVEL (UART_RX_FIFO_SIZE / 4)
+#endif
+
+// Set to 1 to count the cycles spent in the UART interrupt and the bytes it moves
+#ifndef UART_ISR_STATS
+#define UART_ISR_STATS 0
+#endif
+
+#if UART_ISR_STATS
+/*!
+ * @struct TUARTISRStats
+ */
+typedef struct
+{
+  uint32_t NbInterrupts;	/*!< The number of times the UART's interrupt has run */
+  uint32_t NbBytes;		/*!< The number of bytes received and transmitted by the UART interrupt */
+  uint64_t Cycles;		/*!< The total cycles spent in the UART interrupt */
+} TUARTISRStats;
+#endif
+
+/*!
+ * @struct TUARTErrorStats
+ */
+typedef struct
+{
+  uint32_t NbOverruns;		/*!< The number of times a received character was lost because the receiver was full */
+  uint32_t NbNoise;		/*!< The number of characters received with noise */
+  uint32_t NbFraming;		/*!< The number of characters received without a valid stop bit */
+  uint32_t NbParity;		/*!< The number of characters received with a parity error */
+} TUARTErrorStats;
+
+/*! @brief Sets up a UART before first use.
+ *
+ *  The module clock is the core clock for UART0 and UART1 and the bus clock for the others.
+ *  @param port The UART to set up - it must be enabled with its UARTn_ENABLED option.
  *  @param baudRate The desired baud rate in bits/sec.
  *  @return bool - TRUE if the UART was successfully initialized.
  */
-bool UART_Init(const uint32_t moduleClk, const uint32_t baudRate);
- 
+bool UART_Init(const TUARTPort port, const uint32_t baudRate);
+
+/*! @brief Calculates the baud rate divisor for a baud rate using integer arithmetic only.
+ *
+ *  The baud rate is moduleClk / (16 * (sbr + brfa / 32)), so the divisor is rounded to the nearest 1/32.
+ *  @param moduleClk The module clock rate in Hz.
+ *  @param baudRate The desired baud rate in bits/sec.
+ *  @param sbrPtr A pointer to a location to place the 13-bit SBR value.
+ *  @param brfaPtr A pointer to a location to place the 5-bit BRFA value.
+ *  @param errorPPMPtr A pointer to a location to place the error of the achieved baud rate in parts per million.
+ *  @return bool - TRUE if the baud rate can be generated from the module clock.
+ */
+bool UART_CalculateDivisor(const uint32_t moduleClk, const uint32_t baudRate, uint16_t* const sbrPtr, uint8_t* const brfaPtr, int32_t* const errorPPMPtr);
+
+/*! @brief Checks that a baud rate can be generated within UART_BAUD_TOLERANCE_PPM.
+ *
+ *  @param port The UART.
+ *  @param baudRate The desired baud rate in bits/sec.
+ *  @param errorPPMPtr A pointer to a location to place the error of the achieved baud rate in parts per million.
+ *  @return bool - TRUE if the baud rate can be used.
+ *  @note Assumes that UART_Init has been called.
+ */
+bool UART_CheckBaudRate(const TUARTPort port, const uint32_t baudRate, int32_t* const errorPPMPtr);
+
+/*! @brief Changes the baud rate once everything in the transmit FIFO has been sent.
+ *
+ *  @param port The UART.
+ *  @param baudRate The desired baud rate in bits/sec.
+ *  @return bool - TRUE if the baud rate was changed, FALSE if it cannot be generated within UART_BAUD_TOLERANCE_PPM
+ *          or the transmitter did not finish within UART_TX_DRAIN_MARGIN times the time it should take.
+ *  @note Waits for the transmitter to finish, timed with the DWT cycle counter that Events_Init starts.
+ *        Assumes that UART_Init has been called.
+ */
+bool UART_SetBaudRate(const TUARTPort port, const uint32_t baudRate);
+
+/*! @brief Gets the current baud rate and its error.
+ *
+ *  @param port The UART.
+ *  @param baudRatePtr A pointer to a location to place the baud rate that was requested.
+ *  @param errorPPMPtr A pointer to a location to place the error of the achieved baud rate in parts per million.
+ *  @note Assumes that UART_Init has been called.
+ */
+void UART_GetBaudRate(const TUARTPort port, uint32_t* const baudRatePtr, int32_t* const errorPPMPtr);
+
+/*! @brief Sets a function to be called from the receive interrupt whenever data has been added to the receive FIFO.
+ *
+ *  The function then takes the place of the main loop as the only consumer of the receive FIFO,
+ *  and EVENT_UART_RX is no longer set for the UART.
+ *  @param port The UART.
+ *  @param userFunction is a pointer to a user callback function, or NULL to wake the main loop instead.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @note The function runs at UART_IRQ_PRIORITY. Assumes that UART_Init has been called.
+ */
+void UART_SetRxCallback(const TUARTPort port, void (*userFunction)(void*), void* userArguments);
+
 /*! @brief Get a character from the receive FIFO if it is not empty.
  *
+ *  @param port The UART.
  *  @param dataPtr A pointer to memory to store the retrieved byte.
  *  @return bool - TRUE if the receive FIFO returned a character.
  *  @note Assumes that UART_Init has been called.
  */
-bool UART_InChar(uint8_t* const dataPtr);
- 
+bool UART_InChar(const TUARTPort port, uint8_t* const dataPtr);
+
 /*! @brief Put a byte in the transmit FIFO if it is not full.
  *
+ *  @param port The UART.
  *  @param data The byte to be placed in the transmit FIFO.
  *  @return bool - TRUE if the data was placed in the transmit FIFO.
  *  @note Assumes that UART_Init has been called.
  */
-bool UART_OutChar(const uint8_t data);
+bool UART_OutChar(const TUARTPort port, const uint8_t data);
+
+/*! @brief Put a block of bytes in the transmit FIFO.
+ *
+ *  The transmit interrupt is enabled once for the whole block.
+ *  @param port The UART.
+ *  @param data A pointer to the bytes to be placed in the transmit FIFO.
+ *  @param length The number of bytes to send.
+ *  @return size_t - the number of bytes placed in the transmit FIFO.
+ *  @note Assumes that UART_Init has been called.
+ */
+size_t UART_Write(const TUARTPort port, const uint8_t* const data, const size_t length);
+
+/*! @brief Get a block of bytes from the receive FIFO.
+ *
+ *  @param port The UART.
+ *  @param dataPtr A pointer to memory to store the retrieved bytes.
+ *  @param length The maximum number of bytes to retrieve.
+ *  @return size_t - the number of bytes retrieved from the receive FIFO.
+ *  @note Assumes that UART_Init has been called.
+ */
+size_t UART_Read(const TUARTPort port, uint8_t* const dataPtr, const size_t length);
+
+/*! @brief Find the oldest contiguous block of received data without removing it from the receive FIFO.
+ *
+ *  @param port The UART.
+ *  @param dataPtr A pointer to a location to place the address of the oldest received byte.
+ *  @param lengthPtr A pointer to a location to place the number of contiguous bytes at dataPtr.
+ *  @return bool - TRUE if there is received data.
+ *  @note Assumes that UART_Init has been called.
+ */
+bool UART_RxPeek(const TUARTPort port, const uint8_t** const dataPtr, size_t* const lengthPtr);
+
+/*! @brief Release received data that was examined with UART_RxPeek.
+ *
+ *  @param port The UART.
+ *  @param length The number of bytes to release.
+ *  @return bool - TRUE if the data was released, FALSE if it was overwritten while being examined.
+ *  @note Assumes that UART_Init has been called.
+ */
+bool UART_RxConsume(const TUARTPort port, const size_t length);
+
+/*! @brief Checks there is room in the transmit FIFO for a block of data, so it can be sent whole or not at all.
+ *
+ *  If there is not, EVENT_UART_TX is set once the transmit FIFO has emptied.
+ *  @param port The UART.
+ *  @param length The number of bytes to be sent.
+ *  @return bool - TRUE if length bytes can be placed in the transmit FIFO.
+ *  @note Assumes that UART_Init has been called.
+ */
+bool UART_TxAvailable(const TUARTPort port, const size_t length);
+
+/*! @brief Find the contiguous free space in the transmit FIFO so data can be written in place.
+ *
+ *  @param port The UART.
+ *  @param dataPtr A pointer to a location to place the address of the first free byte.
+ *  @param lengthPtr A pointer to a location to place the number of contiguous free bytes at dataPtr.
+ *  @return bool - TRUE if the transmit FIFO is not full.
+ *  @note Assumes that UART_Init has been called.
+ */
+bool UART_TxReserve(const TUARTPort port, uint8_t** const dataPtr, size_t* const lengthPtr);
 
-/*! @brief Poll the UART status register to try and receive and/or transmit one character.
+/*! @brief Send data that was written in place after a call to UART_TxReserve.
  *
- *  @return void
+ *  @param port The UART.
+ *  @param length The number of bytes to send.
  *  @note Assumes that UART_Init has been called.
  */
-void UART_Poll(void);
+void UART_TxCommit(const TUARTPort port, const size_t length);
+
+#if FIFO_STATS
+/*! @brief Takes a snapshot of the usage statistics of the receive and transmit FIFOs.
+ *
+ *  @param port The UART.
+ *  @param rxStats A pointer to a location to place the receive FIFO statistics.
+ *  @param txStats A pointer to a location to place the transmit FIFO statistics.
+ *  @note Assumes that UART_Init has been called.
+ */
+void UART_GetFIFOStats(const TUARTPort port, TFIFOStats* const rxStats, TFIFOStats* const txStats);
+#endif
+
+/*! @brief Takes a snapshot of the receive error counters.
+ *
+ *  @param port The UART.
+ *  @param stats A pointer to a location to place the counters.
+ *  @note Assumes that UART_Init has been called.
+ */
+void UART_GetErrorStats(const TUARTPort port, TUARTErrorStats* const stats);
+
+#if UART_ISR_STATS
+/*! @brief Takes a snapshot of the cost of the UART interrupt.
+ *
+ *  @param port The UART.
+ *  @param stats A pointer to a location to place the statistics.
+ *  @note Assumes that UART_Init has been called.
+ */
+void UART_GetISRStats(const TUARTPort port, TUARTISRStats* const stats);
+#endif
 
 #endif
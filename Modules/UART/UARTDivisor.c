@@ -0,0 +1,52 @@
+/*!
+**  @addtogroup UART_module UART module documentation
+**  @{
+*/
+/* MODULE UART */
+/*! @file UARTDivisor.c
+ *
+ *  @brief Baud rate divisor calculation for the UARTs.
+ *
+ *  This touches no registers, so it can be built and tested on a host as well as the K64.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+#include "UART.h"
+
+//Transmitter is driven by baud rate clock divided by 16
+//Receiver has acquisition rate of 16 samples per bit time
+static const uint8_t SAMPLE_BAUD_RATE = 16;
+//Baud Rate Fractional Divisor adds fine adjustment in steps of 1/32
+static const uint8_t BAUD_RATE_DIVISOR = 32;
+//Largest value of the 13-bit SBR field
+static const uint16_t SBR_MAX = 0x1FFF;
+
+
+bool UART_CalculateDivisor(const uint32_t moduleClk, const uint32_t baudRate, uint16_t* const sbrPtr, uint8_t* const brfaPtr, int32_t* const errorPPMPtr)
+{
+	uint64_t divisor, achieved;
+
+	if (baudRate == 0)
+		return false;
+
+	// The divisor in 1/32 steps, rounded to the nearest step
+	divisor = (((uint64_t)moduleClk * BAUD_RATE_DIVISOR) + ((uint64_t)SAMPLE_BAUD_RATE * baudRate / 2)) / ((uint64_t)SAMPLE_BAUD_RATE * baudRate);
+
+	if ((divisor < BAUD_RATE_DIVISOR) || ((divisor / BAUD_RATE_DIVISOR) > SBR_MAX))
+		return false;
+
+	*sbrPtr = divisor / BAUD_RATE_DIVISOR;
+	*brfaPtr = divisor % BAUD_RATE_DIVISOR;
+
+	// The achieved baud rate in millionths of a bit/sec, compared with the one requested
+	achieved = ((uint64_t)moduleClk * BAUD_RATE_DIVISOR * 1000000) / (SAMPLE_BAUD_RATE * divisor);
+	*errorPPMPtr = (int32_t)(((int64_t)achieved - (int64_t)baudRate * 1000000) / (int64_t)baudRate);
+
+	return true;
+}
+
+/* END UART */
+/*!
+** @}
+*/
@@ -27,6 +27,9 @@
 #include "FTM\FTM.h"
 #include "RTC\RTC.h"
 #include "PIT\PIT.h"
+#include "Events\Events.h"
+#include "Critical\critical.h"
+#include "CRC\CRC.h"
 
 
 
@@ -39,6 +42,37 @@
 #define FLASH_PROGRAM_CMD 0x07
 #define FLASH_READ_CMD 0x08
 #define TIME_CMD 0x0C
+#define FIFO_STATS_CMD 0x20
+#define EVENTS_STATS_CMD 0x21
+#define CRITICAL_PROFILE_CMD 0x22
+#define UART_ISR_STATS_CMD 0x23
+#define BAUD_RATE_CMD 0x24
+#define UART_ERRORS_CMD 0x25
+#define FLASH_DUMP_CMD 0x26
+#define CRC_BENCH_CMD 0x27
+
+// Packets a command may reply with, including its acknowledgement
+#if CRITICAL_PROFILE
+#define MAX_REPLY_PACKETS (2 * (3 + CRITICAL_PROFILE_NB_BUCKETS) + 1) // the critical section profile
+#else
+#define MAX_REPLY_PACKETS (2 * 5 + 1) // the FIFO statistics
+#endif
+
+// Most bytes FLASH_DUMP_CMD returns - the whole Flash data area
+#define FLASH_DUMP_MAX_NB_BYTES (FLASH_DATA_END - FLASH_DATA_START + 1)
+
+// Bytes of the largest reply, which decides how much transmit room to wait for before a command is taken
+#if PACKET_PAYLOAD
+#define MAX_REPLY_NB_BYTES \
+  ((MAX_REPLY_PACKETS * PACKET_NB_BYTES > PACKET_PAYLOAD_NB_BYTES(FLASH_DUMP_MAX_NB_BYTES) + PACKET_NB_BYTES) ? \
+   MAX_REPLY_PACKETS * PACKET_NB_BYTES : PACKET_PAYLOAD_NB_BYTES(FLASH_DUMP_MAX_NB_BYTES) + PACKET_NB_BYTES) // a Flash dump and its acknowledgement
+
+_Static_assert(FLASH_DUMP_MAX_NB_BYTES <= PACKET_PAYLOAD_MAX_NB_BYTES, "a Flash dump must fit in one payload frame");
+#else
+#define MAX_REPLY_NB_BYTES (MAX_REPLY_PACKETS * PACKET_NB_BYTES)
+#endif
+
+_Static_assert(MAX_REPLY_NB_BYTES <= UART_TX_FIFO_SIZE, "the largest reply must fit in the transmit FIFO");
 
 // Version number
 const uint8_t VERSION_MAJOR = 0x01; //1
@@ -48,6 +82,19 @@ const uint8_t VERSION_MINOR = 0x00; //0
 // Baud rate
 const uint32_t BAUD_RATE = 115200;
 
+// The UARTs that carry packets from PCs - each must also be enabled in UART.h
+static const TUARTPort PACKET_PORTS[] = { UART_PORT_0 };
+#define NB_PACKET_PORTS (sizeof(PACKET_PORTS) / sizeof(PACKET_PORTS[0]))
+
+// Bytes checked by each timing of the CRC benchmark
+#define CRC_BENCH_NB_BYTES 256
+
+// Times each check is repeated by the CRC benchmark - the fastest run is reported, so an interrupt during one run does not count
+#define CRC_BENCH_NB_RUNS 4
+
+// How long the PC has to send a valid packet at a new baud rate before the old one is restored, in nanoseconds
+#define BAUD_FALLBACK_TIMEOUT 1000000000
+
 
 // Public Global variables
 TPacket Packet;
@@ -62,6 +109,10 @@ static uint16union_t Mcu_Md; // MCU Mode
 volatile uint16union_t *NvMCUNb;	// The non-volatile MCU number
 volatile uint16union_t *NvMCUMd;	// The non-volatile MCU mode
 
+static TUARTPort BaudPort;		// The UART whose baud rate is being changed
+static uint32_t NewBaudRate;		// A baud rate change agreed with the PC, or 0
+static uint32_t FallbackBaudRate;	// The baud rate to restore if the PC does not follow a change, or 0 once it has
+
 
 // Function Prototypes
 
@@ -80,6 +131,13 @@ static bool SendStartupPackets(void);
 static bool FlashAllocation_Init(void);
 
 
+/*! @brief Initializes the packets on every UART in PACKET_PORTS.
+ *
+ *  @return bool - TRUE if all of the UARTs were successfully initialized.
+ */
+static bool PacketPortsInit(void);
+
+
 /*! @brief Initializes the MCU by initializing all variables and then sending startup packets to the PC.
  *
  *  @return bool - TRUE if sending the startup packets was successful.
@@ -130,6 +188,109 @@ static bool HandleFlashProgram(void);
 static bool HandleFlashRead(void);
 
 
+#if PACKET_PAYLOAD
+/*! @brief Sends a block of the Flash data area in one payload frame.
+ *
+ *  Parameter 1 is the offset into the data area and parameter 2 the number of bytes.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleFlashDumpPacket(void);
+#endif
+
+
+/*! @brief Sends a 32-bit diagnostic value to the PC as two packets.
+ *
+ *  The first packet carries the low half-word and the second the high half-word, with bit 7 of the index set.
+ *
+ *  @param command The command of the diagnostic packets.
+ *  @param index Identifies the value being sent (0 to 127).
+ *  @param value The value to send.
+ *  @return bool - TRUE if both packets were sent successfully.
+ */
+static bool SendDiagnostic(const uint8_t command, const uint8_t index, const uint32_t value);
+
+
+/*! @brief Reports the main loop's wake-up latency (in cycles) and idle time (in tenths of a percent).
+ *
+ *  The idle time is measured since the previous report.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleEventsStatsPacket(void);
+
+
+#if FIFO_STATS
+/*! @brief Reports the usage statistics of a UART FIFO.
+ *
+ *  Parameter 1 selects the receive (0) or transmit (1) FIFO.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleFIFOStatsPacket(void);
+#endif
+
+
+#if CRITICAL_PROFILE
+/*! @brief Reports the profile of a critical section call site.
+ *
+ *  Parameter 1 selects the call site. The call site address, count, worst case cycles
+ *  and histogram buckets are sent in that order.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleCriticalProfilePacket(void);
+#endif
+
+
+/*! @brief Respond to a baud rate packet sent from the PC.
+ *
+ *  Parameter 1 of 1 reports the current baud rate and its error in parts per million.
+ *  Parameter 1 of 2 proposes the baud rate in parameters 2 and 3, in units of 100 bits/sec.
+ *  If it can be generated, the proposal is echoed back at the old baud rate. The MCU changes
+ *  as soon as the echo has been sent, so the PC changes once it has received the echo.
+ *  The PC must then send a valid packet within BAUD_FALLBACK_TIMEOUT or the old baud rate is restored.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleBaudRatePacket(void);
+
+
+/*! @brief Changes to the baud rate agreed with the PC and starts the fallback timeout.
+ */
+static void ChangeBaudRate(void);
+
+
+/*! @brief Restores the old baud rate because the PC did not follow a change.
+ */
+static void RestoreBaudRate(void);
+
+
+#if UART_ISR_STATS
+/*! @brief Reports the cost of the UART interrupt.
+ *
+ *  The number of interrupts, the number of bytes moved, the average cycles per byte
+ *  and whether the hardware FIFOs are in use are sent in that order.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleUARTISRStatsPacket(void);
+#endif
+
+
+/*! @brief Reports the receive errors of the UART the packet came from.
+ *
+ *  The number of overruns, noise, framing and parity errors are sent in that order.
+ *  They can be compared with the idle time from an events statistics packet to relate link errors to CPU load.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleUARTErrorsPacket(void);
+
+
+/*! @brief Reports how long each frame check takes over CRC_BENCH_NB_BYTES bytes, in cycles.
+ *
+ *  The XOR used by 5-byte packets, the CRC-16 and CRC-32 on the CRC peripheral, and the table-driven
+ *  CRC-16 and CRC-32 are sent in that order. The CRC peripheral is only used if CRC_HW is 1 and it passed its
+ *  check in CRC_Init.
+ *  @return bool - TRUE if the packet was handled successfully.
+ */
+static bool HandleCRCBenchPacket(void);
+
+
 /*! @brief Respond to packets sent from the PC.
  *
  *  @note Assumes that MCUInit has been called successfully.
@@ -164,6 +325,13 @@ void RTCCallback(void* arg);
  */
 void FTMCallback(void* arg);
 
+
+/* @brief Signals that the PC did not follow a baud rate change in time.
+ *
+ *  @note Assumes that MCUInit has been called successfully.
+ */
+void BaudTimeoutCallback(void* arg);
+
 TFTMChannel FTM_Timer = {
 		0, 				//channel
 		DEFAULT_SYSTEM_CLOCK,
@@ -213,6 +381,16 @@ static bool FlashAllocation_Init()
 }
 
 
+static bool PacketPortsInit(void)
+{
+	for (size_t i = 0; i < NB_PACKET_PORTS; i++)
+		if (!Packet_Init(PACKET_PORTS[i], BAUD_RATE))
+			return false;
+
+	return true;
+}
+
+
 static bool MCUInit(void)
 {
 	bool init;
@@ -220,11 +398,14 @@ static bool MCUInit(void)
 	BOARD_InitPins();
 	BOARD_InitBootClocks();
 
-	init =	Packet_Init(SystemCoreClock, BAUD_RATE) &&
+	init =	Events_Init() &&
+			PacketPortsInit() &&
 			Flash_Init() &&
 			LEDs_Init() &&
+			CRC_Init() &&
 			//FlashAllocation_Init() &&
 			//PIT_Init(CLOCK_GetFreq(kCLOCK_BusClk), PITCallback,NULL) &&
+			PIT_Init(CLOCK_GetFreq(kCLOCK_BusClk), BaudTimeoutCallback, NULL) &&
 			//RTC_Init(RTCCallback, NULL) &&
 			FTM_Init();
 
@@ -232,6 +413,7 @@ static bool MCUInit(void)
 	if (init)
 	{
 		//PIT_Set(500000000, true); //PIT timer to an interval of 500 ms
+		PIT_Enable(false); // only runs while a baud rate change is on trial
 		FTM_Set (&FTM_Timer);
 
 
@@ -328,6 +510,18 @@ static bool HandleFlashRead(void)
 	return false;
 }
 
+#if PACKET_PAYLOAD
+static bool HandleFlashDumpPacket(void)
+{
+	uint32_t start = FLASH_DATA_START + Packet_Parameter1;
+
+	if ((Packet_Parameter2 == 0) || (Packet_Parameter3 != 0) || (start + Packet_Parameter2 - 1 > FLASH_DATA_END))
+		return false;
+
+	return Packet_PutPayload(FLASH_DUMP_CMD, (const uint8_t*)start, Packet_Parameter2);
+}
+#endif
+
 static bool HandleTimePackets()
 {
 	if ((Packet_Parameter1 >= 0 && Packet_Parameter1 <=23) && //Hours
@@ -343,6 +537,242 @@ static bool HandleTimePackets()
 }
 
 
+static bool SendDiagnostic(const uint8_t command, const uint8_t index, const uint32_t value)
+{
+	uint32union_t diagnostic;
+
+	diagnostic.l = value;
+
+	return Packet_Put(command, index, diagnostic.s.Lo & 0xFF, diagnostic.s.Lo >> 8) &&
+	       Packet_Put(command, index | 0x80, diagnostic.s.Hi & 0xFF, diagnostic.s.Hi >> 8);
+}
+
+static bool HandleEventsStatsPacket(void)
+{
+	TEventsStats stats;
+	uint32_t idlePerMille = 0;
+
+	if ((Packet_Parameter1 != 0) || (Packet_Parameter2 != 0) || (Packet_Parameter3 != 0))
+		return false;
+
+	Events_GetStats(&stats);
+
+	if (stats.TotalCycles)
+		idlePerMille = (uint32_t)((stats.IdleCycles * 1000) / stats.TotalCycles);
+
+	return SendDiagnostic(EVENTS_STATS_CMD, 0, stats.LastLatency) &&
+	       SendDiagnostic(EVENTS_STATS_CMD, 1, stats.MaxLatency) &&
+	       SendDiagnostic(EVENTS_STATS_CMD, 2, idlePerMille);
+}
+
+#if FIFO_STATS
+static bool HandleFIFOStatsPacket(void)
+{
+	TFIFOStats rxStats, txStats;
+	TFIFOStats* stats;
+
+	if ((Packet_Parameter1 > 1) || (Packet_Parameter2 != 0) || (Packet_Parameter3 != 0))
+		return false;
+
+	UART_GetFIFOStats(Packet_Port, &rxStats, &txStats);
+	stats = (Packet_Parameter1 == 0) ? &rxStats : &txStats;
+
+	return SendDiagnostic(FIFO_STATS_CMD, 0, stats->NbPuts) &&
+	       SendDiagnostic(FIFO_STATS_CMD, 1, stats->NbGets) &&
+	       SendDiagnostic(FIFO_STATS_CMD, 2, stats->NbRejected) &&
+	       SendDiagnostic(FIFO_STATS_CMD, 3, stats->PeakNbBytes) &&
+	       SendDiagnostic(FIFO_STATS_CMD, 4, stats->NbNearFull);
+}
+#endif
+
+#if CRITICAL_PROFILE
+static bool HandleCriticalProfilePacket(void)
+{
+	TCriticalProfile profile;
+	bool success;
+
+	if ((Packet_Parameter2 != 0) || (Packet_Parameter3 != 0) || !Critical_GetProfile(Packet_Parameter1, &profile))
+		return false;
+
+	success = SendDiagnostic(CRITICAL_PROFILE_CMD, 0, profile.Site) &&
+	          SendDiagnostic(CRITICAL_PROFILE_CMD, 1, profile.Count) &&
+	          SendDiagnostic(CRITICAL_PROFILE_CMD, 2, profile.MaxCycles);
+
+	for (uint8_t bucket = 0; success && (bucket < CRITICAL_PROFILE_NB_BUCKETS); bucket++)
+		success = SendDiagnostic(CRITICAL_PROFILE_CMD, 3 + bucket, profile.Histogram[bucket]);
+
+	return success;
+}
+#endif
+
+static bool HandleBaudRatePacket(void)
+{
+	uint32_t baudRate;
+	int32_t errorPPM;
+
+	if ((Packet_Parameter1 == 1) && (Packet_Parameter2 == 0) && (Packet_Parameter3 == 0))
+	{
+		UART_GetBaudRate(Packet_Port, &baudRate, &errorPPM);
+
+		return SendDiagnostic(BAUD_RATE_CMD, 0, baudRate) &&
+		       SendDiagnostic(BAUD_RATE_CMD, 1, (uint32_t)errorPPM);
+	}
+	else if (Packet_Parameter1 == 2)
+	{
+		baudRate = (uint32_t)Packet_Parameter23 * 100;
+
+		if (!UART_CheckBaudRate(Packet_Port, baudRate, &errorPPM))
+			return false;
+
+		// A change still on trial on another UART is abandoned, which fails if that UART cannot be restored yet
+		RestoreBaudRate();
+		if (FallbackBaudRate || !Packet_Put(BAUD_RATE_CMD, 2, Packet_Parameter2, Packet_Parameter3))
+			return false;
+
+		// Change once the echo (and any acknowledgement) has been queued
+		BaudPort = Packet_Port;
+		NewBaudRate = baudRate;
+		return true;
+	}
+	else
+		return false;
+}
+
+static void ChangeBaudRate(void)
+{
+	int32_t errorPPM;
+
+	UART_GetBaudRate(BaudPort, &FallbackBaudRate, &errorPPM);
+
+	if (UART_SetBaudRate(BaudPort, NewBaudRate))
+	{
+		Packet_Flush(BaudPort); // anything received during the change is garbage
+		PIT_Set(BAUD_FALLBACK_TIMEOUT, true);
+	}
+	else
+		FallbackBaudRate = 0;
+
+	NewBaudRate = 0;
+}
+
+static void RestoreBaudRate(void)
+{
+	PIT_Enable(false);
+
+	if (FallbackBaudRate)
+	{
+		// If flow control is holding the transmitter up, try again after another timeout
+		if (!UART_SetBaudRate(BaudPort, FallbackBaudRate))
+		{
+			PIT_Set(BAUD_FALLBACK_TIMEOUT, true);
+			return;
+		}
+
+		Packet_Flush(BaudPort);
+		FallbackBaudRate = 0;
+	}
+}
+
+#if UART_ISR_STATS
+static bool HandleUARTISRStatsPacket(void)
+{
+	TUARTISRStats stats;
+	uint32_t cyclesPerByte = 0;
+
+	if ((Packet_Parameter1 != 0) || (Packet_Parameter2 != 0) || (Packet_Parameter3 != 0))
+		return false;
+
+	UART_GetISRStats(Packet_Port, &stats);
+
+	if (stats.NbBytes)
+		cyclesPerByte = (uint32_t)(stats.Cycles / stats.NbBytes);
+
+	return SendDiagnostic(UART_ISR_STATS_CMD, 0, stats.NbInterrupts) &&
+	       SendDiagnostic(UART_ISR_STATS_CMD, 1, stats.NbBytes) &&
+	       SendDiagnostic(UART_ISR_STATS_CMD, 2, cyclesPerByte) &&
+	       SendDiagnostic(UART_ISR_STATS_CMD, 3, UART_HW_FIFO);
+}
+#endif
+
+static bool HandleUARTErrorsPacket(void)
+{
+	TUARTErrorStats stats;
+
+	if ((Packet_Parameter1 != 0) || (Packet_Parameter2 != 0) || (Packet_Parameter3 != 0))
+		return false;
+
+	UART_GetErrorStats(Packet_Port, &stats);
+
+	return SendDiagnostic(UART_ERRORS_CMD, 0, stats.NbOverruns) &&
+	       SendDiagnostic(UART_ERRORS_CMD, 1, stats.NbNoise) &&
+	       SendDiagnostic(UART_ERRORS_CMD, 2, stats.NbFraming) &&
+	       SendDiagnostic(UART_ERRORS_CMD, 3, stats.NbParity);
+}
+
+
+/*! @brief A frame check, as timed by the CRC benchmark.
+ *
+ *  @param data A pointer to the bytes to check.
+ *  @param length The number of bytes.
+ *  @return uint32_t - the checksum or CRC.
+ */
+typedef uint32_t (*TCheck)(const uint8_t* const data, const size_t length);
+
+static uint32_t CheckXOR(const uint8_t* const data, const size_t length)
+{
+	uint8_t sum = 0;
+
+	for (size_t i = 0; i < length; i++)
+		sum ^= data[i];
+
+	return sum;
+}
+
+static uint32_t CheckCRC16(const uint8_t* const data, const size_t length)
+{
+	return CRC_Calculate16(CRC_16_INIT, data, length);
+}
+
+static uint32_t CheckSoftwareCRC16(const uint8_t* const data, const size_t length)
+{
+	return CRC_Software16(CRC_16_INIT, data, length);
+}
+
+static bool HandleCRCBenchPacket(void)
+{
+	static const TCheck CHECKS[] = { CheckXOR, CheckCRC16, CRC_Calculate32, CheckSoftwareCRC16, CRC_Software32 };
+	uint8_t data[CRC_BENCH_NB_BYTES];
+	uint32_t volatile result;
+	bool success = true;
+
+	if ((Packet_Parameter1 != 0) || (Packet_Parameter2 != 0) || (Packet_Parameter3 != 0))
+		return false;
+
+	for (size_t i = 0; i < CRC_BENCH_NB_BYTES; i++)
+		data[i] = (uint8_t)i;
+
+	for (uint8_t check = 0; success && (check < sizeof(CHECKS) / sizeof(CHECKS[0])); check++)
+	{
+		uint32_t best = UINT32_MAX;
+
+		for (uint8_t run = 0; run < CRC_BENCH_NB_RUNS; run++)
+		{
+			uint32_t start = DWT->CYCCNT;
+
+			result = CHECKS[check](data, CRC_BENCH_NB_BYTES);
+
+			uint32_t cycles = DWT->CYCCNT - start;
+			if (cycles < best)
+				best = cycles;
+		}
+
+		(void)result;
+		success = SendDiagnostic(CRC_BENCH_CMD, check, best);
+	}
+
+	return success;
+}
+
 
 /* @brief Respond to packets sent from the PC.
  *
@@ -383,6 +813,45 @@ static void HandlePackets(void)
 		case FLASH_READ_CMD:
 			success = HandleFlashRead();
 			break;
+
+#if PACKET_PAYLOAD
+		case FLASH_DUMP_CMD:
+			success = HandleFlashDumpPacket();
+			break;
+#endif
+
+		case EVENTS_STATS_CMD:
+			success = HandleEventsStatsPacket();
+			break;
+
+#if FIFO_STATS
+		case FIFO_STATS_CMD:
+			success = HandleFIFOStatsPacket();
+			break;
+#endif
+
+#if CRITICAL_PROFILE
+		case CRITICAL_PROFILE_CMD:
+			success = HandleCriticalProfilePacket();
+			break;
+#endif
+		case BAUD_RATE_CMD:
+			success = HandleBaudRatePacket();
+			break;
+
+#if UART_ISR_STATS
+		case UART_ISR_STATS_CMD:
+			success = HandleUARTISRStatsPacket();
+			break;
+#endif
+		case UART_ERRORS_CMD:
+			success = HandleUARTErrorsPacket();
+			break;
+
+		case CRC_BENCH_CMD:
+			success = HandleCRCBenchPacket();
+			break;
+
 		case TIME_CMD:
 			success = HandleTimePackets();
 
@@ -424,6 +893,11 @@ void FTMCallback(void* arg)
 	LEDs_Off(LED_BLUE);
 }
 
+void BaudTimeoutCallback(void* arg)
+{
+	Events_Set(EVENT_BAUD_TIMEOUT);
+}
+
 /*!
  * @brief Main function
  */
@@ -446,10 +920,44 @@ int main(void)
 
 	for (;;)
 	{
-		if (Packet_Get())
+		// Sleep until an interrupt has something for us to do
+		uint32_t events = Events_Wait();
+		bool handled;
+
+		if ((events & EVENT_BAUD_TIMEOUT) && FallbackBaudRate)
+			RestoreBaudRate();
+
+		// Take one packet from each UART in turn so a busy link cannot hold up the others
+		do
 		{
-			HandlePackets();
-		}
+			handled = false;
+
+			for (size_t i = 0; i < NB_PACKET_PORTS; i++)
+			{
+#if PACKET_SEQUENCED
+				// Acknowledge sequenced commands as they are taken, so the PC can keep its window full
+				if (!Packet_Acknowledge(PACKET_PORTS[i]))
+					continue;
+#endif
+
+				// Leave a command queued until its whole reply fits, rather than send part of it or lose it - EVENT_UART_TX retries it
+				if (!UART_TxAvailable(PACKET_PORTS[i], MAX_REPLY_NB_BYTES) || !Packet_Get(PACKET_PORTS[i]))
+					continue;
+
+				// A valid packet at a new baud rate shows the PC has followed the change
+				if (FallbackBaudRate && (Packet_Port == BaudPort))
+				{
+					PIT_Enable(false);
+					FallbackBaudRate = 0;
+				}
+
+				HandlePackets();
+				handled = true;
+
+				if (NewBaudRate)
+					ChangeBaudRate();
+			}
+		} while (handled);
 	}
 }
 
@@ -0,0 +1,111 @@
+/*! @file
+ *
+ *  @brief Cost of the atomics layer against a lock, built for the host.
+ *
+ *  Times a shared counter incremented with Atomic_FetchAdd, with an Atomic_CompareExchange loop, and under a mutex,
+ *  which is the host's equivalent of the critical sections the atomics replaced.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "test.h"
+#include "atomic.h"
+
+// Increments per measurement, shared between the threads
+#define BENCH_NB_OPERATIONS 20000000U
+
+// Most threads incrementing the counter at once
+#define BENCH_MAX_NB_THREADS 4
+
+/*! @brief The ways of incrementing the counter.
+ */
+typedef enum
+{
+  METHOD_FETCH_ADD,
+  METHOD_COMPARE_EXCHANGE,
+  METHOD_MUTEX
+} TMethod;
+
+static const char* const METHOD_NAMES[] = {"Atomic_FetchAdd", "Atomic_CompareExchange loop", "mutex"};
+
+static uint32_t volatile Counter;
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static TMethod Method;
+static uint32_t NbThreads;
+
+
+/*! @brief Increments the counter this thread's share of the times.
+ *
+ *  @param arguments Unused.
+ *  @return void* - NULL.
+ */
+static void* Increment(void* arguments)
+{
+	(void)arguments;
+
+	for (uint32_t i = 0; i < BENCH_NB_OPERATIONS / NbThreads; i++)
+	{
+		uint32_t value;
+
+		switch (Method)
+		{
+			case METHOD_FETCH_ADD:
+				Atomic_FetchAdd(&Counter, 1);
+				break;
+
+			case METHOD_COMPARE_EXCHANGE:
+				do
+					value = Atomic_Load(&Counter);
+				while (!Atomic_CompareExchange(&Counter, value, value + 1));
+				break;
+
+			case METHOD_MUTEX:
+				pthread_mutex_lock(&Lock);
+				Counter++;
+				pthread_mutex_unlock(&Lock);
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+/*! @brief Times one method with a number of threads and prints the cost of each increment.
+ */
+static void Bench(const TMethod method, const uint32_t nbThreads)
+{
+	pthread_t threads[BENCH_MAX_NB_THREADS];
+	struct timespec start, end;
+	double seconds;
+
+	Method = method;
+	NbThreads = nbThreads;
+	Counter = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t i = 0; i < nbThreads; i++)
+		pthread_create(&threads[i], NULL, Increment, NULL);
+	for (uint32_t i = 0; i < nbThreads; i++)
+		pthread_join(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	printf("%-30s %u thread(s) %7.2f ns/increment\n", METHOD_NAMES[method], nbThreads, seconds * 1e9 / BENCH_NB_OPERATIONS);
+	CHECK(Counter == BENCH_NB_OPERATIONS / nbThreads * nbThreads);
+}
+
+
+int main(void)
+{
+	for (TMethod method = METHOD_FETCH_ADD; method <= METHOD_MUTEX; method++)
+	{
+		Bench(method, 1);
+		Bench(method, BENCH_MAX_NB_THREADS);
+	}
+
+	return TEST_RESULT();
+}
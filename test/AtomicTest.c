@@ -0,0 +1,162 @@
+/*! @file
+ *
+ *  @brief Stress tests of the atomics layer, built for the host.
+ *
+ *  Several threads hammer the same variables with each read-modify-write operation, then the results are checked
+ *  for lost updates. On the host the operations are the compiler's atomic builtins that stand in for LDREX/STREX.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "test.h"
+#include "atomic.h"
+
+// Threads hammering the variables, each with its own bit of Flags
+#define NB_THREADS 4
+
+// Operations each thread performs
+#define NB_OPERATIONS 1000000U
+
+/*! @brief A message passed between threads through a pointer.
+ */
+typedef struct
+{
+  uint32_t Number;
+  uint32_t Check;
+} TMessage;
+
+static pthread_barrier_t Start;
+
+static uint32_t volatile Counter;
+static uint32_t volatile CASCounter;
+static uint32_t volatile Flags;
+static uint32_t volatile NbFlagErrors;
+
+static TMessage Messages[2];
+static void* volatile Mailbox;
+static uint32_t volatile NbMessageErrors;
+
+
+/*! @brief Increments the counters and sets and clears the thread's own flag.
+ *
+ *  @param arguments The thread's number.
+ *  @return void* - NULL.
+ */
+static void* Hammer(void* arguments)
+{
+	uint32_t bit = 1U << (uintptr_t)arguments;
+
+	// Start together so the threads overlap as much as possible
+	pthread_barrier_wait(&Start);
+
+	for (uint32_t i = 0; i < NB_OPERATIONS; i++)
+	{
+		uint32_t value;
+
+		Atomic_FetchAdd(&Counter, 1);
+
+		do
+			value = Atomic_Load(&CASCounter);
+		while (!Atomic_CompareExchange(&CASCounter, value, value + 1));
+
+		// Only this thread touches its bit, so it must be as this thread left it
+		if (Atomic_SetBits(&Flags, bit) & bit)
+			Atomic_FetchAdd(&NbFlagErrors, 1);
+		if (!(Atomic_ClearBits(&Flags, bit) & bit))
+			Atomic_FetchAdd(&NbFlagErrors, 1);
+	}
+
+	return NULL;
+}
+
+/*! @brief Publishes messages through Mailbox, alternating between two buffers and filling each one in before its pointer is stored.
+ *
+ *  @param arguments Unused.
+ *  @return void* - NULL.
+ */
+static void* Publisher(void* arguments)
+{
+	(void)arguments;
+
+	for (uint32_t i = 1; i <= NB_OPERATIONS; i++)
+	{
+		TMessage* message = &Messages[i & 1];
+
+		// Wait for the reader to take the previous message
+		while (Atomic_LoadPointer(&Mailbox))
+			sched_yield();
+
+		message->Number = i;
+		message->Check = ~i;
+		Atomic_StorePointer(&Mailbox, message);
+	}
+
+	return NULL;
+}
+
+/*! @brief Checks that every message read through Mailbox is complete and in order, then empties Mailbox.
+ *
+ *  @param arguments Unused.
+ *  @return void* - NULL.
+ */
+static void* Reader(void* arguments)
+{
+	uint32_t last = 0;
+
+	(void)arguments;
+
+	while (last < NB_OPERATIONS)
+	{
+		TMessage* message = Atomic_LoadPointer(&Mailbox);
+
+		if (!message)
+		{
+			sched_yield();
+			continue;
+		}
+
+		if ((message->Number != last + 1) || (message->Check != ~message->Number))
+			NbMessageErrors++;
+		last = message->Number;
+		Atomic_StorePointer(&Mailbox, NULL);
+	}
+
+	return NULL;
+}
+
+
+int main(void)
+{
+	pthread_t threads[NB_THREADS];
+
+	pthread_barrier_init(&Start, NULL, NB_THREADS);
+
+	for (uintptr_t i = 0; i < NB_THREADS; i++)
+		pthread_create(&threads[i], NULL, Hammer, (void*)i);
+	for (int i = 0; i < NB_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	CHECK(Counter == NB_THREADS * NB_OPERATIONS);
+	CHECK(CASCounter == NB_THREADS * NB_OPERATIONS);
+	CHECK(Flags == 0);
+	CHECK(NbFlagErrors == 0);
+
+	pthread_create(&threads[0], NULL, Publisher, NULL);
+	pthread_create(&threads[1], NULL, Reader, NULL);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+	CHECK(NbMessageErrors == 0);
+
+	// Compare-and-swap fails and leaves the variable alone if it has changed
+	CASCounter = 5;
+	CHECK(!Atomic_CompareExchange(&CASCounter, 4, 9));
+	CHECK(CASCounter == 5);
+	CHECK(Atomic_CompareExchange(&CASCounter, 5, 9));
+	CHECK(CASCounter == 9);
+
+	return TEST_RESULT();
+}
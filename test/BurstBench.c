@@ -0,0 +1,96 @@
+/*! @file
+ *
+ *  @brief Command throughput of burst frames against 5-byte packets, built for the host.
+ *
+ *  For each size of burst this gives the bytes each command costs on the line, the commands per second that allows at
+ *  115200 baud, and how fast Packet_Get decodes a stream of such frames on the host. Built once with each frame checksum.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "test.h"
+#include "UARTStub.h"
+#include "packet.h"
+
+// Baud rate the line figures are for, and the bits each byte takes with a start and stop bit
+#define BENCH_BAUD_RATE 115200
+#define BENCH_BITS_PER_BYTE 10
+
+// Commands decoded for each timing
+#define BENCH_NB_COMMANDS 20000000UL
+
+TPacket Packet;
+
+
+/*! @brief Times Packet_Get on a stream of frames of one size and prints the results.
+ *
+ *  @param nbPackets The number of packets in each burst frame, or 0 for 5-byte packets.
+ */
+static void Bench(const uint8_t nbPackets)
+{
+	uint8_t frame[PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS)];
+	TPacket packets[PACKET_BURST_MAX_PACKETS];
+	uint8_t nbCommands = nbPackets ? nbPackets : 1;
+	size_t length;
+	unsigned long nbDecoded = 0;
+	struct timespec start, end;
+	double seconds, bytesPerCommand;
+
+	for (uint8_t i = 0; i < nbCommands; i++)
+	{
+		packets[i].bytes[0] = 0x10 + i;
+		packets[i].bytes[1] = i;
+		packets[i].bytes[2] = 2 * i;
+		packets[i].bytes[3] = 3 * i;
+		packets[i].packetStruct.checksum = packets[i].bytes[0] ^ packets[i].bytes[1] ^ packets[i].bytes[2] ^ packets[i].bytes[3];
+	}
+
+	if (nbPackets)
+		length = Packet_EncodeBurst(frame, packets, nbPackets);
+	else
+	{
+		length = PACKET_NB_BYTES;
+		for (int i = 0; i < PACKET_NB_BYTES; i++)
+			frame[i] = packets[0].bytes[i];
+	}
+
+	Packet_Init(UART_PORT_0, 115200);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (nbDecoded < BENCH_NB_COMMANDS)
+	{
+		FIFO_PutN(UARTStub_RxFIFO, frame, length);
+		while (Packet_Get(UART_PORT_0))
+			nbDecoded++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	bytesPerCommand = (double)length / nbCommands;
+
+	if (nbPackets)
+		printf("burst of %-4u", nbPackets);
+	else
+		printf("%-13s", "5-byte");
+	printf(" %10.2f %10.0f %12.1f\n", bytesPerCommand, BENCH_BAUD_RATE / (BENCH_BITS_PER_BYTE * bytesPerCommand), nbDecoded / seconds * 1e-6);
+
+	// Every frame is decoded as soon as it has been put in, so none is lost or split
+	CHECK(nbDecoded % nbCommands == 0);
+}
+
+
+int main(void)
+{
+	printf("frame checksum: %s\n", PACKET_FRAME_CRC ? "CRC-16/CCITT-FALSE" : "Fletcher-16");
+	printf("%-13s %10s %10s %12s\n", "frame", "bytes/cmd", "cmd/s", "host Mcmd/s");
+
+	Bench(0);
+	for (uint8_t nbPackets = 1; nbPackets <= PACKET_BURST_MAX_PACKETS; nbPackets *= 2)
+		Bench(nbPackets);
+
+	return TEST_RESULT();
+}
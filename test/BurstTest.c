@@ -0,0 +1,167 @@
+/*! @file
+ *
+ *  @brief Unit tests of burst frames, built for the host.
+ *
+ *  Checks that Packet_EncodeBurst and Packet_DecodeBurst agree, that the decoder rejects damaged and malformed frames,
+ *  and that the parser hands out the packets of burst frames mixed with 5-byte packets on the same link, losing only
+ *  the burst a damaged frame carried. Built once with each frame checksum.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "UARTStub.h"
+#include "packet.h"
+
+// Frames sent to the parser
+#define NB_FRAMES 20000
+
+// Most bytes put into the receive FIFO at once
+#define MAX_CHUNK_NB_BYTES 100
+
+TPacket Packet;
+
+
+/*! @brief Makes a packet with random contents and a good checksum.
+ *
+ *  The command is below 0x7C, so the packet can never be mistaken for a frame header.
+ *  @param packet A pointer to the packet.
+ */
+static void RandomPacket(TPacket* const packet)
+{
+	packet->bytes[0] = rand() % 0x7C;
+	for (int i = 1; i < PACKET_NB_BYTES - 1; i++)
+		packet->bytes[i] = rand();
+	packet->packetStruct.checksum = packet->bytes[0] ^ packet->bytes[1] ^ packet->bytes[2] ^ packet->bytes[3];
+}
+
+/*! @brief Checks that every size of burst decodes to the packets it was built from.
+ */
+static void TestRoundTrip(void)
+{
+	uint8_t frame[PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS)];
+	TPacket packets[PACKET_BURST_MAX_PACKETS], decoded[PACKET_BURST_MAX_PACKETS];
+
+	for (uint8_t nbPackets = 1; nbPackets <= PACKET_BURST_MAX_PACKETS; nbPackets++)
+	{
+		for (uint8_t i = 0; i < nbPackets; i++)
+			RandomPacket(&packets[i]);
+
+		CHECK(Packet_EncodeBurst(frame, packets, nbPackets) == (size_t)PACKET_BURST_NB_BYTES(nbPackets));
+		CHECK(Packet_DecodeBurst(frame, PACKET_BURST_NB_BYTES(nbPackets), decoded) == nbPackets);
+		CHECK(memcmp(decoded, packets, nbPackets * sizeof(TPacket)) == 0);
+	}
+
+	// A burst must carry at least one packet and no more than fit
+	CHECK(Packet_EncodeBurst(frame, packets, 0) == 0);
+	CHECK(Packet_EncodeBurst(frame, packets, PACKET_BURST_MAX_PACKETS + 1) == 0);
+}
+
+/*! @brief Checks that the decoder rejects a frame with any bit changed, of the wrong length, or that is not a burst.
+ */
+static void TestRejected(void)
+{
+	uint8_t frame[PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS + 1)];
+	TPacket packets[PACKET_BURST_MAX_PACKETS], decoded[PACKET_BURST_MAX_PACKETS];
+	size_t length;
+
+	for (uint8_t i = 0; i < PACKET_BURST_MAX_PACKETS; i++)
+		RandomPacket(&packets[i]);
+	length = Packet_EncodeBurst(frame, packets, 4);
+
+	for (size_t i = 0; i < length; i++)
+		for (int bit = 0; bit < 8; bit++)
+		{
+			frame[i] ^= 1 << bit;
+			CHECK(Packet_DecodeBurst(frame, length, decoded) == 0);
+			frame[i] ^= 1 << bit;
+		}
+
+	CHECK(Packet_DecodeBurst(frame, length - 1, decoded) == 0);
+	CHECK(Packet_DecodeBurst(frame, length + 1, decoded) == 0);
+	CHECK(Packet_DecodeBurst(packets[0].bytes, PACKET_NB_BYTES, decoded) == 0);
+
+	// A header claiming more packets than a burst may carry is not a burst header, even with a good checksum
+	frame[1] = PACKET_BURST_MAX_PACKETS + 1;
+	frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+	CHECK(Packet_DecodeBurst(frame, PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS + 1), decoded) == 0);
+}
+
+/*! @brief Checks the parser on a stream of burst frames and 5-byte packets, some bursts damaged, arriving in random chunks.
+ */
+static void TestParser(void)
+{
+	static TPacket sent[NB_FRAMES * PACKET_BURST_MAX_PACKETS];
+	uint8_t frame[PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS)];
+	unsigned long nbExpected = 0, nbReceived = 0, nbDamaged = 0;
+
+	CHECK(Packet_Init(UART_PORT_0, 115200));
+
+	for (int f = 0; f < NB_FRAMES; f++)
+	{
+		uint8_t nbPackets = 1 + rand() % PACKET_BURST_MAX_PACKETS;
+		size_t length, chunk;
+		bool damaged = false;
+
+		// Every other frame is a 5-byte packet, and every damaged burst is followed by one, which must still arrive
+		if (f & 1)
+		{
+			RandomPacket(&sent[nbExpected]);
+			memcpy(frame, sent[nbExpected].bytes, PACKET_NB_BYTES);
+			length = PACKET_NB_BYTES;
+			nbPackets = 1;
+		}
+		else
+		{
+			for (uint8_t i = 0; i < nbPackets; i++)
+				RandomPacket(&sent[nbExpected + i]);
+			length = Packet_EncodeBurst(frame, &sent[nbExpected], nbPackets);
+
+			// Damage the packets or the frame checksum of one burst in ten, leaving the header intact
+			if (rand() % 10 == 0)
+			{
+				frame[PACKET_NB_BYTES + rand() % (length - PACKET_NB_BYTES)] ^= 1 + rand() % 255;
+				damaged = true;
+				nbDamaged++;
+			}
+		}
+
+		// The packets the parser should hand out are the good ones, in order, so a damaged burst's are overwritten
+		if (!damaged)
+			nbExpected += nbPackets;
+
+		for (size_t done = 0; done < length; done += chunk)
+		{
+			chunk = 1 + rand() % MAX_CHUNK_NB_BYTES;
+			if (chunk > length - done)
+				chunk = length - done;
+
+			CHECK(FIFO_PutN(UARTStub_RxFIFO, &frame[done], chunk) == chunk);
+
+			while (Packet_Get(UART_PORT_0))
+			{
+				CHECK((nbReceived < nbExpected) && (memcmp(&Packet, &sent[nbReceived], sizeof(TPacket)) == 0));
+				nbReceived++;
+			}
+		}
+	}
+
+	printf("parser: %lu packets received of %lu expected, %lu damaged bursts dropped\n", nbReceived, nbExpected, nbDamaged);
+	CHECK(nbReceived == nbExpected);
+}
+
+
+int main(void)
+{
+	srand(2);
+
+	TestRoundTrip();
+	TestRejected();
+	TestParser();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,101 @@
+/*! @file
+ *
+ *  @brief Speed of the frame checks, built for the host.
+ *
+ *  Times the XOR of 5-byte packets, the Fletcher-16 and table-driven CRC-16 that can end burst and payload frames,
+ *  and the table-driven CRC-32, over blocks the size of the largest payload frame. The CRC peripheral can only be timed
+ *  on the target, with CRC_BENCH_CMD.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "test.h"
+#include "CRC.h"
+#include "UARTStub.h"
+#include "packet.h"
+
+// Bytes in each block, and the blocks checked by each measurement
+#define BENCH_NB_BYTES (PACKET_PAYLOAD_MAX_NB_BYTES + PACKET_NB_BYTES)
+#define BENCH_NB_BLOCKS 200000UL
+
+// The frame checks
+typedef enum
+{
+  CHECK_XOR,
+  CHECK_FLETCHER_16,
+  CHECK_CRC_16,
+  CHECK_CRC_32
+} TCheck;
+
+static const char* const CHECK_NAMES[] = {"XOR", "Fletcher-16", "CRC-16 table", "CRC-32 table"};
+
+TPacket Packet;
+
+static uint8_t Data[BENCH_NB_BYTES];
+
+
+/*! @brief Times one frame check and prints its speed.
+ *
+ *  @param check The frame check.
+ */
+static void Bench(const TCheck check)
+{
+	uint32_t volatile result = 0;
+	struct timespec start, end;
+	double seconds;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned long block = 0; block < BENCH_NB_BLOCKS; block++)
+	{
+		// Change the data so the compiler cannot hoist the check out of the loop
+		Data[0] = (uint8_t)block;
+
+		switch (check)
+		{
+			case CHECK_XOR:
+			{
+				uint8_t sum = 0;
+
+				for (size_t i = 0; i < BENCH_NB_BYTES; i++)
+					sum ^= Data[i];
+				result = sum;
+				break;
+			}
+
+			case CHECK_FLETCHER_16:
+				result = Packet_Fletcher16(Data, BENCH_NB_BYTES);
+				break;
+
+			case CHECK_CRC_16:
+				result = CRC_Software16(CRC_16_INIT, Data, BENCH_NB_BYTES);
+				break;
+
+			case CHECK_CRC_32:
+				result = CRC_Software32(Data, BENCH_NB_BYTES);
+				break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	(void)result;
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	printf("%-14s %8.2f ns/byte %8.0f MB/s\n", CHECK_NAMES[check], seconds * 1e9 / (BENCH_NB_BLOCKS * BENCH_NB_BYTES),
+		BENCH_NB_BLOCKS * BENCH_NB_BYTES / seconds * 1e-6);
+}
+
+
+int main(void)
+{
+	for (size_t i = 0; i < BENCH_NB_BYTES; i++)
+		Data[i] = rand();
+
+	printf("%u-byte blocks\n", BENCH_NB_BYTES);
+	for (TCheck check = CHECK_XOR; check <= CHECK_CRC_32; check++)
+		Bench(check);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,116 @@
+/*! @file
+ *
+ *  @brief Unit tests of the CRC module's software path, built for the host.
+ *
+ *  Checks the standard check values of CRC-16/CCITT-FALSE and CRC-32, CRC-16 blocks split over several calls,
+ *  and both CRCs against bit-at-a-time references. On the host CRC_Calculate16 and CRC_Calculate32 use the tables,
+ *  so they are checked the same way. The peripheral is checked on the target by CRC_Init with CRC_SELF_TEST.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "CRC.h"
+
+// The standard check string, and its CRCs
+#define CHECK_DATA "123456789"
+#define CHECK_NB_BYTES 9
+#define CHECK_CRC_16 0x29B1U
+#define CHECK_CRC_32 0xCBF43926U
+
+// Longest block checked against the references
+#define MAX_NB_BYTES 1024
+
+
+/*! @brief Calculates a CRC-16/CCITT-FALSE a bit at a time.
+ */
+static uint16_t Reference16(uint16_t crc, const uint8_t* const data, const size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		crc ^= (uint16_t)(data[i] << 8);
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+	}
+
+	return crc;
+}
+
+/*! @brief Calculates a CRC-32 a bit at a time.
+ */
+static uint32_t Reference32(const uint8_t* const data, const size_t length)
+{
+	uint32_t crc = 0xFFFFFFFFU;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+	}
+
+	return ~crc;
+}
+
+/*! @brief Checks the standard check values, whole and with the check string split at every point.
+ */
+static void TestCheckValues(void)
+{
+	const uint8_t* data = (const uint8_t*)CHECK_DATA;
+
+	CHECK(CRC_Software16(CRC_16_INIT, data, CHECK_NB_BYTES) == CHECK_CRC_16);
+	CHECK(CRC_Calculate16(CRC_16_INIT, data, CHECK_NB_BYTES) == CHECK_CRC_16);
+	CHECK(CRC_Software32(data, CHECK_NB_BYTES) == CHECK_CRC_32);
+	CHECK(CRC_Calculate32(data, CHECK_NB_BYTES) == CHECK_CRC_32);
+
+	for (size_t split = 0; split <= CHECK_NB_BYTES; split++)
+	{
+		uint16_t crc = CRC_Calculate16(CRC_16_INIT, data, split);
+
+		CHECK(CRC_Calculate16(crc, &data[split], CHECK_NB_BYTES - split) == CHECK_CRC_16);
+	}
+}
+
+/*! @brief Checks both CRCs against the references for every length and alignment, and CRC-16 blocks split in three.
+ */
+static void TestReference(void)
+{
+	static uint8_t data[MAX_NB_BYTES + 3];
+
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+
+	for (size_t length = 0; length <= MAX_NB_BYTES; length++)
+		for (size_t offset = 0; offset < 4; offset++)
+		{
+			const uint8_t* block = &data[offset];
+			uint16_t crc16 = Reference16(CRC_16_INIT, block, length);
+			size_t first = length ? rand() % length : 0;
+			size_t second = (length - first) ? rand() % (length - first) : 0;
+			uint16_t chained;
+
+			CHECK(CRC_Calculate16(CRC_16_INIT, block, length) == crc16);
+			CHECK(CRC_Calculate32(block, length) == Reference32(block, length));
+
+			chained = CRC_Calculate16(CRC_16_INIT, block, first);
+			chained = CRC_Calculate16(chained, &block[first], second);
+			chained = CRC_Calculate16(chained, &block[first + second], length - first - second);
+			CHECK(chained == crc16);
+		}
+}
+
+
+int main(void)
+{
+	srand(4);
+	CHECK(CRC_Init());
+
+	TestCheckValues();
+	TestReference();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,206 @@
+/*! @file
+ *
+ *  @brief Throughput of the FIFO module against the original critical-section FIFO, built for the host.
+ *
+ *  The original FIFO kept a byte count shared by both ends and updated it inside EnterCritical/ExitCritical.
+ *  A copy of it is timed here with the critical section as a mutex, which is what it has to be once the
+ *  two ends run on different host threads, and with no lock at all for the single-thread figures.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "test.h"
+#include "FIFO.h"
+
+// Bytes moved through each FIFO per measurement
+#define BENCH_NB_BYTES 20000000UL
+
+// Size of the original FIFO
+#define OLD_FIFO_SIZE 256
+
+/*! @brief The original FIFO, with its byte count shared by both ends.
+ */
+typedef struct
+{
+  uint16_t Start, End;
+  uint16_t volatile NbBytes;
+  uint8_t Buffer[OLD_FIFO_SIZE];
+  pthread_mutex_t Lock;
+  bool Locked;
+} TOldFIFO;
+
+static TOldFIFO OldFIFO = {.Lock = PTHREAD_MUTEX_INITIALIZER};
+
+FIFO_DEFINE(NewFIFO, 256);
+
+static volatile uint8_t Sink;
+
+
+/*! @brief Puts a byte as the original FIFO_Put did.
+ */
+static bool OldPut(TOldFIFO* const fifo, const uint8_t data)
+{
+	if (fifo->Locked)
+		pthread_mutex_lock(&fifo->Lock);
+
+	if (fifo->NbBytes == OLD_FIFO_SIZE)
+	{
+		if (fifo->Locked)
+			pthread_mutex_unlock(&fifo->Lock);
+		return false;
+	}
+
+	fifo->Buffer[fifo->End] = data;
+	if (fifo->End == OLD_FIFO_SIZE - 1)
+		fifo->End = 0;
+	else
+		fifo->End++;
+	fifo->NbBytes++;
+
+	if (fifo->Locked)
+		pthread_mutex_unlock(&fifo->Lock);
+	return true;
+}
+
+/*! @brief Gets a byte as the original FIFO_Get did.
+ */
+static bool OldGet(TOldFIFO* const fifo, uint8_t* const dataPtr)
+{
+	if (fifo->Locked)
+		pthread_mutex_lock(&fifo->Lock);
+
+	if (fifo->NbBytes == 0)
+	{
+		if (fifo->Locked)
+			pthread_mutex_unlock(&fifo->Lock);
+		return false;
+	}
+
+	*dataPtr = fifo->Buffer[fifo->Start];
+	if (fifo->Start == OLD_FIFO_SIZE - 1)
+		fifo->Start = 0;
+	else
+		fifo->Start++;
+	fifo->NbBytes--;
+
+	if (fifo->Locked)
+		pthread_mutex_unlock(&fifo->Lock);
+	return true;
+}
+
+/*! @brief Seconds on the monotonic clock.
+ */
+static double Now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/*! @brief Prints a throughput.
+ */
+static void Report(const char* const name, const double seconds)
+{
+	printf("%-40s %8.1f MB/s %6.2f ns/byte\n", name, BENCH_NB_BYTES / seconds / 1e6, seconds * 1e9 / BENCH_NB_BYTES);
+}
+
+/*! @brief Times a put and a get of each byte on one thread.
+ */
+static void BenchSingleThread(void)
+{
+	uint8_t data, block[64];
+	double start;
+
+	OldFIFO.Locked = false;
+	start = Now();
+	for (unsigned long i = 0; i < BENCH_NB_BYTES; i++)
+	{
+		OldPut(&OldFIFO, (uint8_t)i);
+		OldGet(&OldFIFO, &data);
+		Sink = data;
+	}
+	Report("original Put/Get, 1 thread", Now() - start);
+
+	FIFO_Init(&NewFIFO, FIFO_POLICY_REJECT);
+	start = Now();
+	for (unsigned long i = 0; i < BENCH_NB_BYTES; i++)
+	{
+		FIFO_Put(&NewFIFO, (uint8_t)i);
+		FIFO_Get(&NewFIFO, &data);
+		Sink = data;
+	}
+	Report("FIFO_Put/FIFO_Get, 1 thread", Now() - start);
+
+	start = Now();
+	for (unsigned long i = 0; i < BENCH_NB_BYTES; i += sizeof(block))
+	{
+		FIFO_PutN(&NewFIFO, block, sizeof(block));
+		FIFO_GetN(&NewFIFO, block, sizeof(block));
+		Sink = block[0];
+	}
+	Report("FIFO_PutN/FIFO_GetN 64 bytes, 1 thread", Now() - start);
+}
+
+/*! @brief Fills the FIFO under test from the second thread.
+ *
+ *  @param arguments Non-NULL for the original FIFO.
+ *  @return void* - NULL.
+ */
+static void* Producer(void* arguments)
+{
+	for (unsigned long i = 0; i < BENCH_NB_BYTES; )
+	{
+		if (arguments ? OldPut(&OldFIFO, (uint8_t)i) : FIFO_Put(&NewFIFO, (uint8_t)i))
+			i++;
+		else
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+/*! @brief Times bytes passing from a producer thread to the main thread.
+ *
+ *  @param old TRUE for the original FIFO.
+ */
+static void BenchTwoThreads(const bool old)
+{
+	pthread_t producer;
+	unsigned long errors = 0;
+	uint8_t data;
+	double start;
+
+	OldFIFO.Locked = true;
+	FIFO_Init(&NewFIFO, FIFO_POLICY_REJECT);
+
+	start = Now();
+	pthread_create(&producer, NULL, Producer, old ? (void*)1 : NULL);
+
+	for (unsigned long i = 0; i < BENCH_NB_BYTES; )
+	{
+		if (old ? OldGet(&OldFIFO, &data) : FIFO_Get(&NewFIFO, &data))
+			errors += (data != (uint8_t)i++);
+		else
+			sched_yield();
+	}
+
+	pthread_join(producer, NULL);
+	Report(old ? "original Put/Get under a mutex, 2 threads" : "FIFO_Put/FIFO_Get, 2 threads", Now() - start);
+	CHECK(errors == 0);
+}
+
+
+int main(void)
+{
+	BenchSingleThread();
+	BenchTwoThreads(true);
+	BenchTwoThreads(false);
+
+	return TEST_RESULT();
+}
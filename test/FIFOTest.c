@@ -0,0 +1,272 @@
+/*! @file
+ *
+ *  @brief Unit tests for the FIFO module, built for the host.
+ *
+ *  Checks the empty and full conditions and wrapping of the ring and its free-running counters,
+ *  then runs a producer and a consumer thread against each other to stress the lock-free ring.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "test.h"
+#include "FIFO.h"
+
+// Bytes passed between the stress test threads
+#define STRESS_NB_BYTES 4000000UL
+
+FIFO_DEFINE(Small, 8);
+FIFO_DEFINE(Stress, 256);
+
+
+/*! @brief Checks that an empty FIFO gives nothing and a full one takes nothing.
+ */
+static void TestEmptyAndFull(void)
+{
+	uint8_t data;
+
+	FIFO_Init(&Small, FIFO_POLICY_REJECT);
+	CHECK(!FIFO_Get(&Small, &data));
+	CHECK(FIFO_NbBytes(&Small) == 0);
+	CHECK(FIFO_Space(&Small) == 8);
+
+	for (uint8_t i = 0; i < 8; i++)
+		CHECK(FIFO_Put(&Small, i));
+
+	CHECK(!FIFO_Put(&Small, 8));
+	CHECK(FIFO_NbBytes(&Small) == 8);
+	CHECK(FIFO_Space(&Small) == 0);
+
+	for (uint8_t i = 0; i < 8; i++)
+		CHECK(FIFO_Get(&Small, &data) && (data == i));
+
+	CHECK(!FIFO_Get(&Small, &data));
+}
+
+/*! @brief Checks that data keeps its order as the ring wraps, including when the free-running counters overflow.
+ */
+static void TestWrap(void)
+{
+	uint8_t next = 0, expected = 0, data;
+
+	FIFO_Init(&Small, FIFO_POLICY_REJECT);
+	Small.Start = Small.End = 0xFFFFFFF0U;
+
+	// Keep 5 bytes in flight so the buffer index wraps on a different byte each lap
+	for (int i = 0; i < 1000; i++)
+	{
+		while (FIFO_NbBytes(&Small) < 5)
+			CHECK(FIFO_Put(&Small, next++));
+
+		CHECK(FIFO_Get(&Small, &data) && (data == expected++));
+	}
+
+	CHECK(Small.End < 0xFFFFFFF0U);
+	while (FIFO_Get(&Small, &data))
+		CHECK(data == expected++);
+	CHECK(expected == next);
+}
+
+/*! @brief Checks that block puts and gets split across the wrap correctly.
+ */
+static void TestBlockWrap(void)
+{
+	uint8_t in[8], out[8];
+
+	FIFO_Init(&Small, FIFO_POLICY_REJECT);
+
+	for (int offset = 0; offset < 8; offset++)
+	{
+		// Move the start of the data to each position in the buffer
+		Small.Start = Small.End = offset;
+
+		for (uint8_t i = 0; i < 8; i++)
+			in[i] = (uint8_t)(offset * 16 + i);
+
+		CHECK(FIFO_PutN(&Small, in, 6) == 6);
+		CHECK(FIFO_GetN(&Small, out, sizeof(out)) == 6);
+		CHECK(memcmp(in, out, 6) == 0);
+	}
+}
+
+/*! @brief Checks that a block put reports only the bytes stored and counts the rest as rejected.
+ */
+static void TestPutNTruncated(void)
+{
+	uint8_t in[12], out[12];
+
+	for (uint8_t i = 0; i < sizeof(in); i++)
+		in[i] = i;
+
+	FIFO_Init(&Small, FIFO_POLICY_REJECT);
+	CHECK(FIFO_PutN(&Small, in, sizeof(in)) == 8);
+	CHECK(Small.Stats.NbPuts == 8);
+	CHECK(Small.Stats.NbRejected == 4);
+	CHECK(FIFO_GetN(&Small, out, sizeof(out)) == 8);
+	CHECK(memcmp(out, in, 8) == 0);
+
+	// Overwriting keeps the newest 8 bytes of an oversized block
+	FIFO_Init(&Small, FIFO_POLICY_OVERWRITE);
+	CHECK(FIFO_PutN(&Small, in, sizeof(in)) == 8);
+	CHECK(Small.Stats.NbPuts == 8);
+	CHECK(Small.Stats.NbRejected == 4);
+	CHECK(FIFO_GetN(&Small, out, sizeof(out)) == 8);
+	CHECK(memcmp(out, &in[4], 8) == 0);
+}
+
+/*! @brief Checks what each overflow policy does with data that arrives when the FIFO is full.
+ */
+static void TestPolicies(void)
+{
+	uint8_t in[20], out[16], data;
+
+	for (uint8_t i = 0; i < sizeof(in); i++)
+		in[i] = 100 + i;
+
+	// Rejecting keeps the oldest data and takes new data again as soon as there is room
+	FIFO_Init(&Small, FIFO_POLICY_REJECT);
+	CHECK(FIFO_PutN(&Small, in, 10) == 8);
+	CHECK(!FIFO_Put(&Small, 1));
+	CHECK(FIFO_Get(&Small, &data) && (data == 100));
+	CHECK(FIFO_Put(&Small, 1));
+
+	// Overwriting keeps the newest data, byte by byte or a block at a time
+	FIFO_Init(&Small, FIFO_POLICY_OVERWRITE);
+	for (uint8_t i = 0; i < 12; i++)
+		CHECK(FIFO_Put(&Small, i));
+	CHECK(FIFO_NbBytes(&Small) == 8);
+	CHECK(FIFO_Get(&Small, &data) && (data == 4));
+	CHECK(FIFO_PutN(&Small, in, sizeof(in)) == 8);
+	CHECK(FIFO_GetN(&Small, out, sizeof(out)) == 8);
+	CHECK((out[0] == 112) && (out[7] == 119));
+
+	// Dropping a burst keeps rejecting, even once there is room, until the burst ends
+	FIFO_Init(&Small, FIFO_POLICY_DROP_BURST);
+	for (uint8_t i = 0; i < 8; i++)
+		CHECK(FIFO_Put(&Small, i));
+	CHECK(!FIFO_Put(&Small, 8));
+	CHECK(FIFO_Get(&Small, &data) && (data == 0));
+	CHECK(!FIFO_Put(&Small, 9));
+	FIFO_EndBurst(&Small);
+	CHECK(FIFO_Put(&Small, 10));
+	CHECK(FIFO_PutN(&Small, in, 3) == 0);
+	FIFO_EndBurst(&Small);
+	CHECK(FIFO_GetN(&Small, out, sizeof(out)) == 8);
+	CHECK((out[0] == 1) && (out[7] == 10));
+	CHECK(FIFO_PutN(&Small, in, 3) == 3);
+}
+
+/*! @brief Checks that data written into the buffer by hardware is added, including exactly one whole lap.
+ */
+static void TestCommitUpTo(void)
+{
+	uint8_t out[8];
+
+	FIFO_Init(&Small, FIFO_POLICY_OVERWRITE);
+	memcpy(Small.Buffer, "abcdefgh", 8);
+	CHECK(FIFO_CommitUpTo(&Small, 3, false) == 3);
+	CHECK(FIFO_CommitUpTo(&Small, 3, false) == 0);
+
+	// Back at index 3 after a whole lap - the oldest data has been written over
+	memcpy(Small.Buffer, "ABCDEFGH", 8);
+	CHECK(FIFO_CommitUpTo(&Small, 3, true) == 8);
+	CHECK(Small.Stats.NbRejected == 3);
+	CHECK(FIFO_GetN(&Small, out, sizeof(out)) == 8);
+	CHECK(memcmp(out, "DEFGHABC", 8) == 0);
+
+	// The flag only matters when the index has not moved
+	CHECK(FIFO_CommitUpTo(&Small, 5, true) == 2);
+}
+
+/*! @brief Puts a counting sequence into the stress FIFO, a byte or a block at a time.
+ *
+ *  @param arguments Non-NULL to put blocks.
+ *  @return void* - NULL.
+ */
+static void* Producer(void* arguments)
+{
+	uint8_t block[37];
+	unsigned long sent = 0;
+
+	while (sent < STRESS_NB_BYTES)
+	{
+		if (arguments)
+		{
+			size_t length = sizeof(block);
+
+			if (length > STRESS_NB_BYTES - sent)
+				length = STRESS_NB_BYTES - sent;
+
+			for (size_t i = 0; i < length; i++)
+				block[i] = (uint8_t)(sent + i);
+
+			length = FIFO_PutN(&Stress, block, length);
+			sent += length;
+
+			if (length == 0)
+				sched_yield();
+		}
+		else if (FIFO_Put(&Stress, (uint8_t)sent))
+			sent++;
+		else
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+/*! @brief Runs a producer thread against the main thread as consumer and checks nothing is lost, repeated or reordered.
+ *
+ *  @param blocks TRUE to put and get blocks, FALSE for single bytes.
+ */
+static void TestStress(const bool blocks)
+{
+	pthread_t producer;
+	uint8_t block[29];
+	unsigned long received = 0, errors = 0;
+
+	FIFO_Init(&Stress, FIFO_POLICY_REJECT);
+	pthread_create(&producer, NULL, Producer, blocks ? (void*)1 : NULL);
+
+	while (received < STRESS_NB_BYTES)
+	{
+		if (blocks)
+		{
+			size_t length = FIFO_GetN(&Stress, block, sizeof(block));
+
+			for (size_t i = 0; i < length; i++)
+				errors += (block[i] != (uint8_t)(received + i));
+			received += length;
+
+			if (length == 0)
+				sched_yield();
+		}
+		else if (FIFO_Get(&Stress, block))
+			errors += (block[0] != (uint8_t)received++);
+		else
+			sched_yield();
+	}
+
+	pthread_join(producer, NULL);
+	CHECK(errors == 0);
+	CHECK(FIFO_NbBytes(&Stress) == 0);
+}
+
+
+int main(void)
+{
+	TestEmptyAndFull();
+	TestWrap();
+	TestBlockWrap();
+	TestPutNTruncated();
+	TestPolicies();
+	TestCommitUpTo();
+	TestStress(false);
+	TestStress(true);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,126 @@
+/*! @file
+ *
+ *  @brief A simulation of RTS/CTS flow control on the receive FIFO fill levels, built for the host.
+ *
+ *  Time runs in character times. The PC sends whenever RTS is asserted, finishing up to SKID_NB_BYTES more after it is
+ *  deasserted. The UART's hardware FIFO deasserts RTS at the receive watermark, as RXRTSE does. The receive interrupt
+ *  moves bytes into the receive FIFO and stops taking them at UART_RTS_STOP_LEVEL, and the main loop, which now and then
+ *  stalls for a flash erase, restarts it at UART_RTS_START_LEVEL. The same traffic is run without flow control to
+ *  show what it saves.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+
+#include "test.h"
+#include "UART.h"
+
+// Character times simulated
+#define NB_TICKS 20000000L
+
+// Depth of the UART's hardware receive FIFO
+#define HW_FIFO_DEPTH 8
+
+// Characters the PC may still send after RTS is deasserted
+#define SKID_NB_BYTES 2
+
+// Chance in a million per character time that the main loop stalls, and how long it stalls for
+#define STALL_PER_MILLION 20
+#define STALL_NB_TICKS 200000L
+
+FIFO_DEFINE(RxFIFO, UART_RX_FIFO_SIZE);
+
+
+/*! @brief Runs the simulation and checks the received data.
+ *
+ *  @param flowControl TRUE to hold the PC off with RTS.
+ *  @return unsigned long - the number of characters lost.
+ */
+static unsigned long Simulate(const bool flowControl)
+{
+	unsigned long nbSent = 0, nbReceived = 0, nbLost = 0, nbOutOfOrder = 0;
+	uint32_t peak = 0;
+	int hwNbBytes = 0, skid = 0;
+	long stall = 0;
+	bool throttled = false;
+	uint8_t sent = 0, expected = 0, data;
+
+	srand(3);
+	FIFO_Init(&RxFIFO, FIFO_POLICY_REJECT);
+
+	for (long tick = 0; tick < NB_TICKS; tick++)
+	{
+		bool rts = !flowControl || (hwNbBytes < UART_RX_WATERMARK);
+		bool arrived = false;
+
+		// The PC notices RTS has gone a few characters late
+		if (rts)
+			skid = SKID_NB_BYTES;
+		if (rts || (skid && skid--))
+		{
+			nbSent++;
+			arrived = true;
+			if (hwNbBytes < HW_FIFO_DEPTH)
+				hwNbBytes++;
+			else
+				nbLost++; // overrun
+		}
+
+		// The receive interrupt at the watermark, or the idle interrupt for the bytes below it
+		if (!throttled && hwNbBytes && ((hwNbBytes >= UART_RX_WATERMARK) || !arrived))
+		{
+			for (; hwNbBytes; hwNbBytes--)
+				if (!FIFO_Put(&RxFIFO, sent++))
+					nbLost++;
+
+			if (flowControl && (FIFO_NbBytes(&RxFIFO) >= UART_RTS_STOP_LEVEL))
+				throttled = true;
+		}
+
+		if (FIFO_NbBytes(&RxFIFO) > peak)
+			peak = FIFO_NbBytes(&RxFIFO);
+
+		// The main loop keeps up, taking up to two bytes a character time, unless a flash erase holds it up
+		if (stall)
+		{
+			stall--;
+			continue;
+		}
+		if (rand() % 1000000 < STALL_PER_MILLION)
+		{
+			stall = STALL_NB_TICKS;
+			continue;
+		}
+		for (int i = 0; (i < 2) && FIFO_Get(&RxFIFO, &data); i++)
+		{
+			// Lost bytes leave gaps, so only follow the sequence when nothing has been lost
+			if (!nbLost && (data != expected))
+				nbOutOfOrder++;
+			expected = data + 1;
+			nbReceived++;
+
+			if (throttled && (FIFO_NbBytes(&RxFIFO) <= UART_RTS_START_LEVEL))
+				throttled = false;
+		}
+	}
+
+	printf("%-22s sent %8lu received %8lu lost %8lu peak fill %4u/%u\n", flowControl ? "with flow control" : "without flow control",
+		nbSent, nbReceived, nbLost, peak, UART_RX_FIFO_SIZE);
+	CHECK(nbOutOfOrder == 0);
+
+	if (flowControl)
+		CHECK(peak <= UART_RTS_STOP_LEVEL + HW_FIFO_DEPTH);
+
+	return nbLost;
+}
+
+
+int main(void)
+{
+	CHECK(Simulate(true) == 0);
+	CHECK(Simulate(false) > 0);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,131 @@
+/*! @file
+ *
+ *  @brief Speed of the packet parser on clean, random and corrupted streams, built for the host.
+ *
+ *  Packet_Get is timed against the parser it replaced, which checked the window at one offset per pass and released
+ *  the receive FIFO one byte at a time after a bad checksum. Both parse the same streams through the same stand-in UART,
+ *  fed in 128-byte chunks, and must decode the same number of packets.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "test.h"
+#include "UARTStub.h"
+#include "packet.h"
+#include "PacketPrevious.h"
+
+// Bytes in each stream, and the times each parser parses it
+#define BENCH_STREAM_NB_BYTES 65536
+#define BENCH_NB_PASSES 400
+
+// Bytes put into the receive FIFO at once
+#define BENCH_CHUNK_NB_BYTES 128
+
+TPacket Packet;
+
+static uint8_t Stream[BENCH_STREAM_NB_BYTES];
+
+
+/*! @brief Parses the stream with one of the parsers.
+ *
+ *  @param previous TRUE for the previous parser, FALSE for Packet_Get.
+ *  @param secondsPtr A pointer to a location to place the time taken.
+ *  @return unsigned long - the number of packets decoded.
+ */
+static unsigned long Run(const bool previous, double* const secondsPtr)
+{
+	unsigned long nbPackets = 0;
+	struct timespec start, end;
+
+	if (previous)
+		PacketPrevious_Init(UART_PORT_0, 115200);
+	else
+		Packet_Init(UART_PORT_0, 115200);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int pass = 0; pass < BENCH_NB_PASSES; pass++)
+		for (size_t sent = 0; sent < BENCH_STREAM_NB_BYTES; sent += BENCH_CHUNK_NB_BYTES)
+		{
+			FIFO_PutN(UARTStub_RxFIFO, &Stream[sent], BENCH_CHUNK_NB_BYTES);
+
+			if (previous)
+				while (PacketPrevious_Get(UART_PORT_0))
+					nbPackets++;
+			else
+				while (Packet_Get(UART_PORT_0))
+					nbPackets++;
+		}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	*secondsPtr = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	return nbPackets;
+}
+
+/*! @brief Fills the stream with packets, some of them damaged.
+ *
+ *  @param nbBadPerHundred How many packets in a hundred have a byte changed.
+ */
+static void MakePackets(const int nbBadPerHundred)
+{
+	for (size_t i = 0; i < BENCH_STREAM_NB_BYTES; i += PACKET_NB_BYTES)
+	{
+		uint8_t* frame = &Stream[i];
+
+		// The stream does not hold a whole number of packets, so the last one is cut short
+		if (i + PACKET_NB_BYTES > BENCH_STREAM_NB_BYTES)
+		{
+			memset(frame, 0, BENCH_STREAM_NB_BYTES - i);
+			break;
+		}
+
+		for (int j = 0; j < PACKET_NB_BYTES - 1; j++)
+			frame[j] = rand();
+		frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+
+		if (rand() % 100 < nbBadPerHundred)
+			frame[rand() % PACKET_NB_BYTES] ^= 1 + rand() % 255;
+	}
+}
+
+/*! @brief Times both parsers on the stream and prints the results.
+ *
+ *  @param name The kind of stream.
+ */
+static void Bench(const char* const name)
+{
+	double previousSeconds, seconds;
+	unsigned long previousNbPackets = Run(true, &previousSeconds);
+	unsigned long nbPackets = Run(false, &seconds);
+	double nbBytes = (double)BENCH_STREAM_NB_BYTES * BENCH_NB_PASSES;
+
+	printf("%-22s %8.1f %8.1f %10.1f %10.1f %10lu\n", name, nbBytes / previousSeconds * 1e-6, nbBytes / seconds * 1e-6,
+		nbPackets / previousSeconds * 1e-6, nbPackets / seconds * 1e-6, nbPackets / BENCH_NB_PASSES);
+	CHECK(nbPackets == previousNbPackets);
+}
+
+
+int main(void)
+{
+	srand(1);
+	printf("%-22s %8s %8s %10s %10s %10s\n", "stream", "MB/s was", "MB/s now", "Mpkt/s was", "Mpkt/s now", "pkts/pass");
+
+	MakePackets(0);
+	Bench("valid packets");
+
+	for (size_t i = 0; i < BENCH_STREAM_NB_BYTES; i++)
+		Stream[i] = rand();
+	Bench("random bytes");
+
+	MakePackets(10);
+	Bench("10% damaged packets");
+
+	MakePackets(25);
+	Bench("25% damaged packets");
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,163 @@
+/*! @file
+ *
+ *  @brief The packet parser as it was before it resynchronised with a rolling-checksum window, kept for PacketBench.
+ *
+ *  Only receiving is kept. It has its own file, as it had in packet.c, so the compiler optimises it as it does the current parser.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <string.h>
+
+#include "PacketPrevious.h"
+#include "atomic.h"
+
+// Number of decoded packets that can wait for the command handlers, as PACKET_QUEUE_SIZE in packet.c
+#define PACKET_QUEUE_SIZE 16
+
+/*!
+ * @struct TPacketContext
+ *
+ *  The parser state and packet queue of one UART.
+ *  The parser only writes QueueEnd and the dispatcher only writes QueueStart.
+ */
+typedef struct
+{
+  TPacket Pending;			/*!< A frame that has not fully arrived, or straddles the end of the receive FIFO */
+  uint8_t NbPendingBytes;		/*!< The number of bytes of a frame already copied into Pending */
+  TPacket Queue[PACKET_QUEUE_SIZE];	/*!< Decoded packets waiting for the command handlers */
+  uint32_t volatile QueueStart;		/*!< The count of packets taken out of the queue */
+  uint32_t volatile QueueEnd;		/*!< The count of packets put into the queue */
+} TPacketContext;
+
+static TPacketContext Contexts[UART_NB_PORTS];
+
+
+/*! @brief Checks the checksum of a frame.
+ *
+ *  @param frame A pointer to the PACKET_NB_BYTES bytes of the frame.
+ *  @return bool - TRUE if the checksum is correct.
+ */
+static bool PacketValid(const uint8_t* const frame)
+{
+	return ((frame[0] ^ frame[1] ^ frame[2] ^ frame[3]) == frame[4]);
+}
+
+/*! @brief Attempts to decode one packet from the data received on a UART.
+ *
+ *  @param port The UART.
+ *  @param packet A pointer to a location to place the decoded packet.
+ *  @return bool - TRUE if a valid packet was decoded.
+ */
+static bool Decode(const TUARTPort port, TPacket* const packet)
+{
+	TPacketContext* const context = &Contexts[port];
+	const uint8_t* data;
+	size_t length;
+
+	while (UART_RxPeek(port, &data, &length))
+	{
+		// Fast path: a whole frame lies contiguously in the receive FIFO, so validate it in place
+		if ((context->NbPendingBytes == 0) && (length >= PACKET_NB_BYTES))
+		{
+			if (PacketValid(data))
+			{
+				memcpy(packet->bytes, data, PACKET_NB_BYTES);
+
+				// The frame is only good if it was not overwritten while it was being copied
+				if (UART_RxConsume(port, PACKET_NB_BYTES))
+					return true; // packet received
+
+				continue;
+			}
+
+			// Checksum does not add up, slide along one byte and look for another one
+			UART_RxConsume(port, 1);
+			continue;
+		}
+
+		// Slow path: the frame straddles the end of the buffer or has not fully arrived
+		if (length > (size_t)(PACKET_NB_BYTES - context->NbPendingBytes))
+			length = PACKET_NB_BYTES - context->NbPendingBytes;
+
+		memcpy(&context->Pending.bytes[context->NbPendingBytes], data, length);
+		if (!UART_RxConsume(port, length))
+			continue; // overwritten while it was being copied, so look again
+
+		context->NbPendingBytes += length;
+
+		if (context->NbPendingBytes == PACKET_NB_BYTES)
+		{
+			if (PacketValid(context->Pending.bytes))
+			{
+				*packet = context->Pending;
+				context->NbPendingBytes = 0; // packet received is valid, start afresh
+				return true; // packet received
+			}
+
+			// Checksum does not add up, right shift bytes and look for another one
+			memmove(&context->Pending.bytes[0], &context->Pending.bytes[1], PACKET_NB_BYTES - 1);
+			context->NbPendingBytes = PACKET_NB_BYTES - 1;
+		}
+	}
+
+	return false;
+}
+
+/*! @brief Decodes as many packets from the data received on a UART as there is room for in its packet queue.
+ *
+ *  @param port The UART.
+ *  @return uint8_t - the number of packets decoded.
+ */
+static uint8_t Parse(const TUARTPort port)
+{
+	TPacketContext* const context = &Contexts[port];
+	uint8_t nbDecoded = 0;
+	uint32_t end = context->QueueEnd;
+
+	// Decode straight into the queue while there is room
+	while (((end - Atomic_Load(&context->QueueStart)) < PACKET_QUEUE_SIZE) && Decode(port, &context->Queue[end & (PACKET_QUEUE_SIZE - 1)]))
+	{
+		end++;
+		nbDecoded++;
+
+		// The packet must be in the queue before the dispatcher can see the new QueueEnd
+		Atomic_Store(&context->QueueEnd, end);
+	}
+
+	return nbDecoded;
+}
+
+
+bool PacketPrevious_Init(const TUARTPort port, const uint32_t baudRate)
+{
+	TPacketContext* const context = &Contexts[port];
+
+	context->NbPendingBytes = 0;
+	context->QueueStart = context->QueueEnd = 0;
+
+	return UART_Init(port, baudRate);
+}
+
+
+bool PacketPrevious_Get(const TUARTPort port)
+{
+	TPacketContext* const context = &Contexts[port];
+	uint32_t start = context->QueueStart;
+	uint32_t end;
+
+	Parse(port);
+
+	end = Atomic_Load(&context->QueueEnd);
+	if (start == end)
+		return false;
+
+	Packet = context->Queue[start & (PACKET_QUEUE_SIZE - 1)];
+	Packet_Port = port;
+
+	// The packet must have been copied before the parser can reuse its location
+	Atomic_Store(&context->QueueStart, start + 1);
+
+	return true;
+}
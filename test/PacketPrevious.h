@@ -0,0 +1,29 @@
+/*! @file
+ *
+ *  @brief The packet parser as it was before it resynchronised with a rolling-checksum window, kept for PacketBench.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#ifndef PACKETPREVIOUS_H
+#define PACKETPREVIOUS_H
+
+#include "packet.h"
+
+/*! @brief Packet_Init as it was.
+ *
+ *  @param port The UART to carry the packets.
+ *  @param baudRate The desired baud rate in bits/sec.
+ *  @return bool - TRUE if the packet module was successfully initialized.
+ */
+bool PacketPrevious_Init(const TUARTPort port, const uint32_t baudRate);
+
+/*! @brief Packet_Get as it was, sliding along one byte per pass after a bad checksum.
+ *
+ *  @param port The UART.
+ *  @return bool - TRUE if a valid packet was placed in Packet.
+ */
+bool PacketPrevious_Get(const TUARTPort port);
+
+#endif
@@ -0,0 +1,234 @@
+/*! @file
+ *
+ *  @brief Unit tests of how the packet parser finds its place in a corrupted stream, built for the host.
+ *
+ *  The stream is fed to the parser in chunks of random size, so frames arrive in pieces and straddle the end of the
+ *  receive FIFO, and the packets decoded are checked against a reference that tries every byte offset in turn.
+ *  Packets are also put into a transmit FIFO that is drained at random, to check that no frame is ever cut short.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "UARTStub.h"
+#include "packet.h"
+
+// Bytes in each corrupted stream, and the streams tried
+#define STREAM_NB_BYTES 20000
+#define NB_STREAMS 50
+
+// Most bytes put into the receive FIFO at once
+#define MAX_CHUNK_NB_BYTES 100
+
+// Packets put into the transmit FIFO, and the most bytes the transmitter takes between two of them
+#define NB_PUTS 1000000
+#define MAX_DRAIN_NB_BYTES 9
+
+TPacket Packet;
+
+
+/*! @brief Decodes a stream the slow way, by checking the window at each byte offset in turn.
+ *
+ *  @param stream A pointer to the stream.
+ *  @param length The number of bytes in the stream.
+ *  @param packets A pointer to space for the packets decoded.
+ *  @return size_t - the number of packets decoded.
+ */
+static size_t Reference(const uint8_t* const stream, const size_t length, TPacket* const packets)
+{
+	size_t nbPackets = 0;
+
+	for (size_t i = 0; i + PACKET_NB_BYTES <= length; )
+	{
+		if ((stream[i] ^ stream[i + 1] ^ stream[i + 2] ^ stream[i + 3]) == stream[i + 4])
+		{
+			memcpy(packets[nbPackets++].bytes, &stream[i], PACKET_NB_BYTES);
+			i += PACKET_NB_BYTES;
+		}
+		else
+			i++;
+	}
+
+	return nbPackets;
+}
+
+/*! @brief Feeds a stream to the parser in chunks of random size and takes every packet it decodes.
+ *
+ *  @param stream A pointer to the stream.
+ *  @param length The number of bytes in the stream.
+ *  @param packets A pointer to space for the packets decoded.
+ *  @return size_t - the number of packets decoded.
+ */
+static size_t Parse(const uint8_t* const stream, const size_t length, TPacket* const packets)
+{
+	size_t nbPackets = 0;
+
+	CHECK(Packet_Init(UART_PORT_0, 115200));
+
+	for (size_t sent = 0; sent < length; )
+	{
+		size_t chunk = 1 + rand() % MAX_CHUNK_NB_BYTES;
+
+		if (chunk > length - sent)
+			chunk = length - sent;
+
+		sent += FIFO_PutN(UARTStub_RxFIFO, &stream[sent], chunk);
+
+		while (Packet_Get(UART_PORT_0))
+			packets[nbPackets++] = Packet;
+	}
+
+	return nbPackets;
+}
+
+/*! @brief Makes a packet with random contents and a good checksum.
+ *
+ *  @param frame A pointer to the PACKET_NB_BYTES bytes of the packet.
+ */
+static void RandomPacket(uint8_t* const frame)
+{
+	for (int i = 0; i < PACKET_NB_BYTES - 1; i++)
+		frame[i] = rand();
+	frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+}
+
+/*! @brief Checks that a stream of good packets is decoded whole, however it arrives.
+ */
+static void TestValid(void)
+{
+	static uint8_t stream[STREAM_NB_BYTES];
+	static TPacket packets[STREAM_NB_BYTES / PACKET_NB_BYTES];
+
+	for (size_t i = 0; i < STREAM_NB_BYTES; i += PACKET_NB_BYTES)
+		RandomPacket(&stream[i]);
+
+	CHECK(Parse(stream, STREAM_NB_BYTES, packets) == STREAM_NB_BYTES / PACKET_NB_BYTES);
+	CHECK(memcmp(packets, stream, STREAM_NB_BYTES) == 0);
+}
+
+/*! @brief Checks that the parser skips bytes that cannot start a packet and decodes the packet after them.
+ */
+static void TestGarbage(void)
+{
+	// No window of the garbage, or of the garbage and the start of the packet, adds up
+	static const uint8_t GOOD[PACKET_NB_BYTES] = {0x10, 0x20, 0x40, 0x08, 0x78};
+	uint8_t stream[64 + PACKET_NB_BYTES];
+	TPacket packets[2];
+
+	for (size_t nbGarbage = 0; nbGarbage <= 64; nbGarbage++)
+	{
+		memset(stream, 0x01, nbGarbage);
+		memcpy(&stream[nbGarbage], GOOD, PACKET_NB_BYTES);
+
+		CHECK(Parse(stream, nbGarbage + PACKET_NB_BYTES, packets) == 1);
+		CHECK(memcmp(packets[0].bytes, GOOD, PACKET_NB_BYTES) == 0);
+	}
+}
+
+/*! @brief Checks the parser against the reference on streams with bytes changed, lost and inserted.
+ */
+static void TestCorrupted(void)
+{
+	static uint8_t stream[STREAM_NB_BYTES];
+	static TPacket expected[STREAM_NB_BYTES / PACKET_NB_BYTES], packets[STREAM_NB_BYTES / PACKET_NB_BYTES];
+	unsigned long nbSent = 0, nbDecoded = 0;
+
+	for (int s = 0; s < NB_STREAMS; s++)
+	{
+		size_t length = 0, nbExpected;
+
+		while (length + PACKET_NB_BYTES <= STREAM_NB_BYTES)
+		{
+			RandomPacket(&stream[length]);
+			nbSent++;
+
+			// One packet in ten loses a byte, gains one, or has one changed
+			switch (rand() % 30)
+			{
+				case 0:
+					memmove(&stream[length + 2], &stream[length + 3], PACKET_NB_BYTES - 3);
+					length--;
+					break;
+
+				case 1:
+					if (length + PACKET_NB_BYTES + 1 > STREAM_NB_BYTES)
+						break;
+					memmove(&stream[length + 3], &stream[length + 2], PACKET_NB_BYTES - 2);
+					stream[length + 2] = rand();
+					length++;
+					break;
+
+				case 2:
+					stream[length + rand() % PACKET_NB_BYTES] ^= 1 << (rand() % 6);
+					break;
+			}
+
+			length += PACKET_NB_BYTES;
+		}
+
+		nbExpected = Reference(stream, length, expected);
+		CHECK(Parse(stream, length, packets) == nbExpected);
+		CHECK(memcmp(packets, expected, nbExpected * sizeof(TPacket)) == 0);
+		nbDecoded += nbExpected;
+	}
+
+	printf("corrupted streams: %lu packets sent, %lu decoded\n", nbSent, nbDecoded);
+}
+
+
+/*! @brief Checks that Packet_Put queues whole frames or nothing while the transmitter drains at random.
+ */
+static void TestPut(void)
+{
+	uint8_t frame[PACKET_NB_BYTES], data;
+	uint8_t nbFrameBytes = 0;
+	uint16_t nbQueued = 0, nbSent = 0;
+	unsigned long nbFull = 0;
+
+	CHECK(Packet_Init(UART_PORT_0, 115200));
+
+	for (unsigned long i = 0; i < NB_PUTS; i++)
+	{
+		bool room = (FIFO_Space(UARTStub_TxFIFO) >= PACKET_NB_BYTES);
+
+		// Each packet carries its number, so a frame cut short or lost shows up as well as one that is malformed
+		CHECK(Packet_CanPut(UART_PORT_0, 1) == room);
+		CHECK(Packet_Put(0x10, (uint8_t)nbQueued, (uint8_t)(nbQueued >> 8), 0) == room);
+		if (room)
+			nbQueued++;
+		else
+			nbFull++;
+
+		for (int n = rand() % (MAX_DRAIN_NB_BYTES + 1); (n > 0) && FIFO_Get(UARTStub_TxFIFO, &data); n--)
+		{
+			frame[nbFrameBytes++] = data;
+			if (nbFrameBytes == PACKET_NB_BYTES)
+			{
+				CHECK((frame[0] == 0x10) && (frame[1] == (uint8_t)nbSent) && (frame[2] == (uint8_t)(nbSent >> 8)) && (frame[3] == 0));
+				CHECK((frame[0] ^ frame[1] ^ frame[2] ^ frame[3]) == frame[4]);
+				nbSent++;
+				nbFrameBytes = 0;
+			}
+		}
+	}
+
+	printf("puts: %lu packets queued, %lu refused with the transmit FIFO full\n", NB_PUTS - nbFull, nbFull);
+	CHECK(nbFull > 0);
+}
+
+
+int main(void)
+{
+	srand(1);
+
+	TestValid();
+	TestGarbage();
+	TestCorrupted();
+	TestPut();
+
+	return TEST_RESULT();
+}
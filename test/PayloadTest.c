@@ -0,0 +1,155 @@
+/*! @file
+ *
+ *  @brief Unit tests of payload frames, built for the host.
+ *
+ *  Frames are sent with Packet_PutPayload into the stand-in transmit FIFO and read back with Packet_DecodePayload.
+ *  Built once with each frame checksum.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "UARTStub.h"
+#include "packet.h"
+
+// Longest block the Fletcher-16 checksum is checked on, well past the bytes its sums take before they are reduced
+#define FLETCHER_MAX_NB_BYTES 70000
+
+// The payload's command in every frame
+#define PAYLOAD_COMMAND 0x26
+
+TPacket Packet;
+
+
+/*! @brief Calculates a Fletcher-16 checksum the slow way, reducing the sums after every byte.
+ */
+static uint16_t Fletcher16(const uint8_t* const data, const size_t length)
+{
+	uint32_t sum1 = 0, sum2 = 0;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		sum1 = (sum1 + data[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+
+	return (uint16_t)((sum2 << 8) | sum1);
+}
+
+/*! @brief Takes everything sent so far out of the transmit FIFO.
+ *
+ *  @param frame A pointer to space for the bytes sent.
+ *  @return size_t - the number of bytes sent.
+ */
+static size_t Sent(uint8_t* const frame)
+{
+	return FIFO_GetN(UARTStub_TxFIFO, frame, UARTSTUB_TX_FIFO_SIZE);
+}
+
+/*! @brief Checks that every payload length can be sent and decoded back, and that a longer one is refused.
+ */
+static void TestRoundTrip(void)
+{
+	uint8_t data[PACKET_PAYLOAD_MAX_NB_BYTES + 1], frame[UARTSTUB_TX_FIFO_SIZE];
+	const uint8_t* payload;
+	uint16_t payloadLength;
+	uint8_t command;
+
+	for (uint16_t length = 0; length <= PACKET_PAYLOAD_MAX_NB_BYTES; length++)
+	{
+		for (uint16_t i = 0; i < length; i++)
+			data[i] = rand();
+
+		CHECK(Packet_PutPayload(PAYLOAD_COMMAND, data, length));
+		CHECK(Sent(frame) == (size_t)PACKET_PAYLOAD_NB_BYTES(length));
+		CHECK(Packet_DecodePayload(frame, PACKET_PAYLOAD_NB_BYTES(length), &command, &payload, &payloadLength));
+		CHECK((command == PAYLOAD_COMMAND) && (payloadLength == length) && (memcmp(payload, data, length) == 0));
+
+		// The header is an ordinary packet, so a receiver that only knows 5-byte packets can step over the frame
+		CHECK((frame[0] ^ frame[1] ^ frame[2] ^ frame[3]) == frame[4]);
+	}
+
+	CHECK(!Packet_PutPayload(PAYLOAD_COMMAND, data, PACKET_PAYLOAD_MAX_NB_BYTES + 1));
+	CHECK(Sent(frame) == 0);
+}
+
+/*! @brief Checks that a frame that does not fit in the transmit FIFO is not sent at all.
+ */
+static void TestNoRoom(void)
+{
+	uint8_t data[PACKET_PAYLOAD_MAX_NB_BYTES] = {0}, frame[UARTSTUB_TX_FIFO_SIZE];
+	size_t free = UARTSTUB_TX_FIFO_SIZE - PACKET_PAYLOAD_NB_BYTES(16) + 1;
+
+	// Leave one byte too few for a 16-byte payload
+	for (size_t i = 0; i < free; i++)
+		CHECK(UART_OutChar(UART_PORT_0, 0));
+
+	CHECK(!Packet_PutPayload(PAYLOAD_COMMAND, data, 16));
+	CHECK(Sent(frame) == free);
+
+	CHECK(Packet_PutPayload(PAYLOAD_COMMAND, data, 16));
+	CHECK(Sent(frame) == (size_t)PACKET_PAYLOAD_NB_BYTES(16));
+}
+
+/*! @brief Checks that the decoder rejects a frame with any bit changed, of the wrong length, or that is not a payload frame.
+ */
+static void TestRejected(void)
+{
+	uint8_t data[32], frame[UARTSTUB_TX_FIFO_SIZE];
+	const uint8_t* payload;
+	uint16_t payloadLength;
+	uint8_t command;
+	size_t length;
+
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+	Packet_PutPayload(PAYLOAD_COMMAND, data, sizeof(data));
+	length = Sent(frame);
+
+	for (size_t i = 0; i < length; i++)
+		for (int bit = 0; bit < 8; bit++)
+		{
+			frame[i] ^= 1 << bit;
+			CHECK(!Packet_DecodePayload(frame, length, &command, &payload, &payloadLength));
+			frame[i] ^= 1 << bit;
+		}
+
+	CHECK(!Packet_DecodePayload(frame, length - 1, &command, &payload, &payloadLength));
+	CHECK(!Packet_DecodePayload(frame, length + 1, &command, &payload, &payloadLength));
+	CHECK(!Packet_DecodePayload(frame, PACKET_NB_BYTES, &command, &payload, &payloadLength));
+}
+
+/*! @brief Checks Packet_Fletcher16 against the slow reference, including blocks long enough to need reducing part way.
+ */
+static void TestFletcher16(void)
+{
+	static uint8_t data[FLETCHER_MAX_NB_BYTES];
+
+	// All 0xFF bytes make the sums grow fastest
+	memset(data, 0xFF, sizeof(data));
+	CHECK(Packet_Fletcher16(data, sizeof(data)) == Fletcher16(data, sizeof(data)));
+
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+
+	for (size_t length = 0; length <= FLETCHER_MAX_NB_BYTES; length += 1 + length / 8)
+		CHECK(Packet_Fletcher16(data, length) == Fletcher16(data, length));
+}
+
+
+int main(void)
+{
+	srand(3);
+	CHECK(Packet_Init(UART_PORT_0, 115200));
+
+	TestRoundTrip();
+	TestNoRoom();
+	TestRejected();
+	TestFletcher16();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,166 @@
+/*! @file
+ *
+ *  @brief Unit tests of how the packet parser recovers from receive FIFO overflows under each overflow policy, built for the host.
+ *
+ *  The PC sends numbered packets in bursts separated by idle gaps, while the main loop now and then stops taking
+ *  packets for long enough that the receive FIFO overflows. For each policy this counts the packets delivered,
+ *  false packets decoded from misaligned bytes, and the bytes the parser had to skip to find its place again, and
+ *  checks them against the figures the policy has achieved, so a change that makes recovery worse fails.
+ *
+ *  Every packet has the same command, so a window one byte out of step still has a valid XOR checksum and the parser
+ *  can stay misaligned until something realigns it, such as the clean start of a burst that FIFO_POLICY_DROP_BURST gives.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+
+#include "test.h"
+#include "UARTStub.h"
+#include "packet.h"
+
+// Packets the PC sends for each policy
+#define NB_PACKETS 2000000UL
+
+// Packets in each burst, after which the line goes idle
+#define BURST_NB_PACKETS 32
+
+// Chance in 1000 per packet that the main loop becomes busy, and the longest it stays busy, in byte times
+#define BUSY_PER_MILLE 20
+#define BUSY_MAX_NB_BYTES 1000
+
+// The command of every packet the PC sends
+#define PACKET_CMD 0x10
+
+/*!
+ * @struct TRecovery
+ *
+ *  How well the parser recovered from the overflows under one policy.
+ */
+typedef struct
+{
+  double Delivered;		/*!< The percentage of the packets sent that were delivered */
+  unsigned long NbFalse;	/*!< The number of false packets decoded */
+  double SkippedPerOverflow;	/*!< The bytes skipped to find the parser's place again, per overflow */
+} TRecovery;
+
+TPacket Packet;
+
+
+/*! @brief Hashes a packet number, so that bytes of neighbouring packets seldom line up into a valid frame.
+ */
+static uint8_t Hash(const uint16_t number)
+{
+	return (uint8_t)((number * 0x9E3779B1U) >> 24);
+}
+
+/*! @brief Checks that a decoded packet is one the PC sent.
+ *
+ *  Parameters 1 and 2 carry a 16-bit packet number and parameter 3 a hash of it.
+ *  @param number A pointer to the number of the last genuine packet, updated if this one is genuine.
+ *  @return bool - TRUE if Packet is a later packet than the last genuine one.
+ */
+static bool Genuine(uint16_t* const number)
+{
+	if ((Packet_Command != PACKET_CMD) || (Packet_Parameter3 != Hash(Packet_Parameter12)))
+		return false;
+
+	// Numbers wrap, but far fewer than 32768 packets are ever lost in a row
+	if ((int16_t)(Packet_Parameter12 - *number) <= 0)
+		return false;
+
+	*number = Packet_Parameter12;
+	return true;
+}
+
+/*! @brief Runs the simulation for one receive FIFO policy and prints the results.
+ *
+ *  @param policy The receive FIFO policy.
+ *  @param name The policy's name.
+ *  @return TRecovery - how well the parser recovered.
+ */
+static TRecovery Simulate(const TFIFOPolicy policy, const char* const name)
+{
+	TRecovery recovery;
+	unsigned long nbDelivered = 0, nbFalse = 0, nbOverflows = 0, nbDecodedBytes = 0;
+	uint32_t nbRejected = 0;
+	uint16_t number = 0;
+	bool overflowing = false;
+	long busy = 0;
+
+	srand(1);
+	UARTStub_RxPolicy = policy;
+	Packet_Init(UART_PORT_0, 115200);
+
+	for (unsigned long i = 1; i <= NB_PACKETS; i++)
+	{
+		uint8_t frame[PACKET_NB_BYTES] = {PACKET_CMD, (uint8_t)i, (uint8_t)(i >> 8), Hash((uint16_t)i)};
+
+		frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+		for (int j = 0; j < PACKET_NB_BYTES; j++)
+		{
+			FIFO_Put(UARTStub_RxFIFO, frame[j]);
+
+			// An overflow is counted each time the receiver starts losing data
+			if ((UARTStub_RxFIFO->Stats.NbRejected != nbRejected) && !overflowing)
+				nbOverflows++;
+			overflowing = (UARTStub_RxFIFO->Stats.NbRejected != nbRejected);
+			nbRejected = UARTStub_RxFIFO->Stats.NbRejected;
+
+			// The main loop takes packets between any two bytes unless it is busy
+			if (busy > 0)
+			{
+				busy--;
+				continue;
+			}
+
+			while (Packet_Get(UART_PORT_0))
+			{
+				nbDecodedBytes += PACKET_NB_BYTES;
+				if (Genuine(&number))
+					nbDelivered++;
+				else
+					nbFalse++;
+			}
+
+			if (rand() % (1000 * PACKET_NB_BYTES) < BUSY_PER_MILLE)
+				busy = rand() % BUSY_MAX_NB_BYTES;
+		}
+
+		// The idle-line interrupt ends the burst
+		if (i % BURST_NB_PACKETS == 0)
+			FIFO_EndBurst(UARTStub_RxFIFO);
+	}
+
+	recovery.Delivered = 100.0 * nbDelivered / NB_PACKETS;
+	recovery.NbFalse = nbFalse;
+	recovery.SkippedPerOverflow = nbOverflows ? (double)(UARTStub_RxFIFO->Stats.NbGets - nbDecodedBytes) / nbOverflows : 0.0;
+
+	printf("%-12s %9.2f%% %10lu %10lu %12.1f\n", name, recovery.Delivered, recovery.NbFalse, nbOverflows, recovery.SkippedPerOverflow);
+	CHECK(nbOverflows > 0);
+	return recovery;
+}
+
+
+int main(void)
+{
+	TRecovery reject, overwrite, dropBurst;
+
+	printf("%-12s %10s %10s %10s %12s\n", "policy", "delivered", "false", "overflows", "skipped/ovf");
+	reject = Simulate(FIFO_POLICY_REJECT, "reject");
+	overwrite = Simulate(FIFO_POLICY_OVERWRITE, "overwrite");
+	dropBurst = Simulate(FIFO_POLICY_DROP_BURST, "drop-burst");
+
+	// The simulation is the same every run, so these are the figures each policy achieves, with a little slack
+	CHECK((reject.Delivered >= 52.0) && (reject.NbFalse <= 210000) && (reject.SkippedPerOverflow <= 3.5));
+	CHECK((overwrite.Delivered >= 51.0) && (overwrite.NbFalse <= 225000) && (overwrite.SkippedPerOverflow <= 3.5));
+	CHECK((dropBurst.Delivered >= 55.5) && (dropBurst.NbFalse <= 2000) && (dropBurst.SkippedPerOverflow <= 2.0));
+
+	// Dropping the rest of a burst is the receive default because the parser is never left out of step with the
+	// next burst, so it must deliver more and decode a small fraction of the false packets the other policies do
+	CHECK(dropBurst.Delivered > reject.Delivered);
+	CHECK(dropBurst.NbFalse * 50 < reject.NbFalse);
+
+	return TEST_RESULT();
+}
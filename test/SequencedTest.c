@@ -0,0 +1,263 @@
+/*! @file
+ *
+ *  @brief Unit tests of sequenced frames, built for the host.
+ *
+ *  Sequenced frames are put into the stand-in receive FIFO, and the packets Packet_Get hands out and the
+ *  acknowledgements Packet_Acknowledge sends back are checked. Built once with each frame checksum.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "UARTStub.h"
+#include "packet.h"
+
+// Packets sent in order, enough for the sequence number to wrap more than once
+#define NB_IN_ORDER 600
+
+TPacket Packet;
+
+
+/*! @brief Makes a packet from its sequence number, so the packet handed out shows which one it was.
+ *
+ *  @param sequence The packet's sequence number.
+ *  @param packet A pointer to the packet.
+ */
+static void SequencePacket(const unsigned sequence, TPacket* const packet)
+{
+	packet->bytes[0] = 0x10;
+	packet->bytes[1] = (uint8_t)sequence;
+	packet->bytes[2] = (uint8_t)(sequence >> 8);
+	packet->bytes[3] = 0x5A;
+	packet->packetStruct.checksum = packet->bytes[0] ^ packet->bytes[1] ^ packet->bytes[2] ^ packet->bytes[3];
+}
+
+/*! @brief Puts a sequenced frame into the receive FIFO.
+ *
+ *  @param first The sequence number of the first packet.
+ *  @param nbPackets The number of packets, or 0 to start a new sequence at first.
+ *  @param damage A value XORed into the frame checksum, or 0 for a good frame.
+ */
+static void Send(const unsigned first, const uint8_t nbPackets, const uint8_t damage)
+{
+	uint8_t frame[PACKET_BURST_NB_BYTES(PACKET_BURST_MAX_PACKETS)];
+	TPacket packets[PACKET_BURST_MAX_PACKETS];
+	size_t length;
+
+	for (uint8_t i = 0; i < nbPackets; i++)
+		SequencePacket(first + i, &packets[i]);
+
+	length = Packet_EncodeSequenced(frame, packets, nbPackets, (uint8_t)first);
+	CHECK(length == (size_t)PACKET_BURST_NB_BYTES(nbPackets));
+	frame[length - 1] ^= damage;
+
+	CHECK(FIFO_PutN(UARTStub_RxFIFO, frame, length) == length);
+}
+
+/*! @brief Checks that the next packets handed out are a run of sequence numbers, and that nothing follows them.
+ *
+ *  @param first The sequence number of the first packet expected.
+ *  @param nbPackets The number of packets expected.
+ */
+static void Receive(const unsigned first, const unsigned nbPackets)
+{
+	TPacket expected;
+
+	for (unsigned i = 0; i < nbPackets; i++)
+	{
+		SequencePacket(first + i, &expected);
+		CHECK(Packet_Get(UART_PORT_0) && (memcmp(&Packet, &expected, sizeof(TPacket)) == 0));
+	}
+
+	CHECK(!Packet_Get(UART_PORT_0));
+}
+
+/*! @brief Lets the parser send an acknowledgement if one is due, and takes it out of the transmit FIFO.
+ *
+ *  @param expectedPtr A pointer to a location to place the next sequence number expected.
+ *  @param heldPtr A pointer to a location to place the bitmap of later packets held.
+ *  @return bool - TRUE if an acknowledgement was sent.
+ */
+static bool Acknowledgement(uint8_t* const expectedPtr, uint16_t* const heldPtr)
+{
+	uint8_t frame[UARTSTUB_TX_FIFO_SIZE];
+	size_t length;
+
+	CHECK(Packet_Acknowledge(UART_PORT_0));
+
+	length = FIFO_GetN(UARTStub_TxFIFO, frame, UARTSTUB_TX_FIFO_SIZE);
+	if (length == 0)
+		return false;
+
+	CHECK((length == PACKET_NB_BYTES) && (frame[0] == PACKET_SEQ_ACK_CMD));
+	CHECK((frame[0] ^ frame[1] ^ frame[2] ^ frame[3]) == frame[4]);
+
+	*expectedPtr = frame[1];
+	*heldPtr = frame[2] | ((uint16_t)frame[3] << 8);
+	return true;
+}
+
+/*! @brief Checks that an acknowledgement is sent now, and what it says.
+ *
+ *  @param expected The next sequence number the acknowledgement should expect.
+ *  @param held The bitmap of later packets it should report held.
+ */
+static void CheckAcknowledged(const uint8_t expected, const uint16_t held)
+{
+	uint8_t ackExpected;
+	uint16_t ackHeld;
+
+	CHECK(Acknowledgement(&ackExpected, &ackHeld) && (ackExpected == expected) && (ackHeld == held));
+}
+
+/*! @brief Restarts the parser and starts a new sequence.
+ *
+ *  @param first The sequence number of the first packet of the new sequence.
+ */
+static void Restart(const uint8_t first)
+{
+	CHECK(Packet_Init(UART_PORT_0, 115200));
+	FIFO_GetN(UARTStub_TxFIFO, NULL, UARTSTUB_TX_FIFO_SIZE);
+
+	Send(first, 0, 0);
+	Receive(0, 0);
+	CheckAcknowledged(first, 0);
+}
+
+/*! @brief Checks that frames sent in order are handed out in order, across the sequence number wrapping round.
+ */
+static void TestInOrder(void)
+{
+	unsigned sequence = 0;
+	uint8_t ackExpected;
+	uint16_t ackHeld;
+
+	Restart(0);
+
+	while (sequence < NB_IN_ORDER)
+	{
+		// Never more outstanding than the window allows
+		uint8_t nbPackets = 1 + rand() % PACKET_SEQ_WINDOW;
+
+		Send(sequence, nbPackets, 0);
+		Receive(sequence, nbPackets);
+		sequence += nbPackets;
+
+		// Once every packet has been taken an acknowledgement of all of them is due
+		CHECK(Acknowledgement(&ackExpected, &ackHeld) && (ackExpected == (uint8_t)sequence) && (ackHeld == 0));
+	}
+}
+
+/*! @brief Checks that a resent frame is handed out only once, and that the resend is acknowledged at once.
+ */
+static void TestResend(void)
+{
+	Restart(40);
+
+	Send(40, 3, 0);
+	Receive(40, 3);
+	CheckAcknowledged(43, 0);
+
+	// The acknowledgement was lost, so the PC resends
+	Send(40, 3, 0);
+	Receive(0, 0);
+	CheckAcknowledged(43, 0);
+
+	// A resend overlapping new packets hands out only the new ones
+	Send(42, 4, 0);
+	Receive(43, 3);
+	CheckAcknowledged(46, 0);
+}
+
+/*! @brief Checks that packets arriving ahead of a lost one are held until it is resent, and the loss is reported at once.
+ */
+static void TestOutOfOrder(void)
+{
+	Restart(250);
+
+	// 250 and 251 are lost, so 252 is held as bit 1 of the bitmap (251 would be bit 0)
+	Send(252, 1, 0);
+	Receive(0, 0);
+	CheckAcknowledged(250, 0x0002);
+
+	// 254 and 255 as well, across the wrap of the sequence number at 256
+	Send(254, 2, 0);
+	Receive(0, 0);
+	CheckAcknowledged(250, 0x001A);
+
+	// Resending 250 and 251 frees 252, and 254 and 255 wait on 253
+	Send(250, 2, 0);
+	Receive(250, 3);
+	CheckAcknowledged(253, 0x0003);
+
+	Send(253, 1, 0);
+	Receive(253, 3);
+	CheckAcknowledged(0, 0);
+
+	// Beyond the window is more than the PC may have outstanding, so it is dropped and the PC told where it is
+	Send(PACKET_SEQ_WINDOW, 1, 0);
+	Receive(0, 0);
+	CheckAcknowledged(0, 0);
+}
+
+/*! @brief Checks that a reset frame with a bad frame checksum leaves the sequence alone, and a good one restarts it.
+ */
+static void TestReset(void)
+{
+	Restart(10);
+
+	// Hold 12, waiting for 10 and 11
+	Send(12, 1, 0);
+	Receive(0, 0);
+	CheckAcknowledged(10, 0x0002);
+
+	for (uint8_t bit = 0; bit < 8; bit++)
+	{
+		uint8_t ackExpected;
+		uint16_t ackHeld;
+
+		Send(100, 0, 1 << bit);
+		Receive(0, 0);
+		CHECK(!Acknowledgement(&ackExpected, &ackHeld));
+	}
+
+	// 12 is still held, and the sequence still expects 10
+	Send(10, 2, 0);
+	Receive(10, 3);
+	CheckAcknowledged(13, 0);
+
+	// Hold 14, then start a new sequence, which drops it
+	Send(14, 1, 0);
+	Receive(0, 0);
+	CheckAcknowledged(13, 0x0001);
+
+	Send(100, 0, 0);
+	Receive(0, 0);
+	CheckAcknowledged(100, 0);
+
+	// Packets of the old sequence are no longer in the window
+	Send(13, 2, 0);
+	Receive(0, 0);
+	CheckAcknowledged(100, 0);
+
+	Send(100, 2, 0);
+	Receive(100, 2);
+	CheckAcknowledged(102, 0);
+}
+
+
+int main(void)
+{
+	srand(5);
+
+	TestInOrder();
+	TestResend();
+	TestOutOfOrder();
+	TestReset();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,77 @@
+/*! @file
+ *
+ *  @brief Unit tests for the UART baud rate divisor calculation, built for the host.
+ *
+ *  For each standard baud rate and each module clock the K64 runs its UARTs from, the divisor chosen by
+ *  UART_CalculateDivisor is checked against an exhaustive search of every SBR and BRFA, and the error it reports
+ *  is checked against the true error.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "UART.h"
+
+// Divisor steps per unit of SBR, and the largest divisor in those steps
+#define STEPS_PER_SBR 32
+#define MAX_DIVISOR (0x1FFF * STEPS_PER_SBR + STEPS_PER_SBR - 1)
+
+static const uint32_t MODULE_CLOCKS[] = {20971520, 48000000, 60000000, 120000000};
+
+static const uint32_t BAUD_RATES[] =
+{
+  1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1000000, 1500000, 2000000, 3000000
+};
+
+
+/*! @brief The error of the baud rate a divisor gives, in parts per million.
+ */
+static double ErrorPPM(const uint32_t moduleClk, const uint32_t baudRate, const uint32_t divisor)
+{
+	double achieved = (double)moduleClk * STEPS_PER_SBR / (16.0 * divisor);
+
+	return (achieved - baudRate) * 1e6 / baudRate;
+}
+
+
+int main(void)
+{
+	for (size_t c = 0; c < sizeof(MODULE_CLOCKS) / sizeof(MODULE_CLOCKS[0]); c++)
+	{
+		double worstPPM = 0;
+
+		for (size_t b = 0; b < sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]); b++)
+		{
+			uint32_t moduleClk = MODULE_CLOCKS[c], baudRate = BAUD_RATES[b], best = 0;
+			uint16_t sbr;
+			uint8_t brfa;
+			int32_t errorPPM;
+			bool possible;
+
+			for (uint32_t divisor = STEPS_PER_SBR; divisor <= MAX_DIVISOR; divisor++)
+				if (!best || (fabs(ErrorPPM(moduleClk, baudRate, divisor)) < fabs(ErrorPPM(moduleClk, baudRate, best))))
+					best = divisor;
+
+			// A rate is possible if even the smallest divisor is not too fast, which the search cannot tell
+			possible = ((uint64_t)moduleClk >= 16ULL * baudRate);
+			CHECK(UART_CalculateDivisor(moduleClk, baudRate, &sbr, &brfa, &errorPPM) == possible);
+			if (!possible)
+				continue;
+
+			CHECK(brfa < STEPS_PER_SBR);
+			CHECK(fabs(ErrorPPM(moduleClk, baudRate, sbr * STEPS_PER_SBR + brfa)) <= fabs(ErrorPPM(moduleClk, baudRate, best)));
+			CHECK(fabs(errorPPM - ErrorPPM(moduleClk, baudRate, sbr * STEPS_PER_SBR + brfa)) <= 1.0);
+
+			if (abs(errorPPM) > fabs(worstPPM))
+				worstPPM = errorPPM;
+		}
+
+		printf("%9u Hz: worst error %+.0f ppm\n", MODULE_CLOCKS[c], worstPPM);
+	}
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,332 @@
+/*! @file
+ *
+ *  @brief A simulation of the UART receive interrupt's idle line handling, built for the host.
+ *
+ *  The receiver's registers are modelled as the K64 reference manual describes them: RDRF is set while the hardware FIFO
+ *  holds at least the watermark, IDLE is set when the line goes idle after a character, and IDLE is only cleared by
+ *  reading S1 with it set and then D. The interrupt handler's receive half (IRQHandler, RxDrain, RxIdleNeeded, RxIRQMask
+ *  and ClearIdle in UART.c, without the eDMA) runs against the model, into the real FIFO. It is also run as a naive
+ *  handler would, turning the idle line interrupt off after every burst and trusting the IDLE read on entry even after
+ *  draining, when it may only mark an earlier gap on the line - both strand the end of a packet, which shows the checks
+ *  would catch either mistake.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "UART.h"
+#include "packet.h"
+
+// The S1 flags the receive interrupt reads
+#define S1_RDRF 0x20U
+#define S1_IDLE 0x10U
+
+// Depth of the hardware receive FIFO of UART0 and UART1, and of UART2-5
+#define HW_FIFO_DEPTH 8
+#define HW_FIFO_DEPTH_SMALL 1
+
+// Packets sent with random gaps, and the largest receive FIFO used
+#define NB_PACKETS 20000
+#define RX_FIFO_SIZE 256
+
+/*!
+ * @struct TReceiver
+ *
+ *  The receiver's state, as the interrupt handler sees it through S1, D, RCFIFO, RWFIFO and C2.
+ */
+typedef struct
+{
+  uint8_t HW[HW_FIFO_DEPTH];	/*!< The hardware receive FIFO */
+  uint8_t Depth;		/*!< Its depth */
+  uint8_t NbBytes;		/*!< RCFIFO */
+  uint8_t Watermark;		/*!< RWFIFO */
+  bool Idle;			/*!< S1 IDLE */
+  bool IdleRead;		/*!< S1 has been read with IDLE set, so reading D clears it */
+  bool Received;		/*!< A character has arrived since IDLE was cleared, so IDLE may be set again */
+  bool IdleInterrupt;		/*!< C2 ILIE */
+  unsigned long NbOverruns;	/*!< Characters lost because the hardware FIFO was full */
+} TReceiver;
+
+static TReceiver Receiver;
+
+FIFO_DEFINE(RxFIFO, RX_FIFO_SIZE);
+
+
+/*! @brief Reads S1, returning RDRF and IDLE.
+ */
+static uint8_t ReadS1(void)
+{
+	Receiver.IdleRead = Receiver.Idle;
+
+	return ((Receiver.NbBytes >= Receiver.Watermark) ? S1_RDRF : 0) | (Receiver.Idle ? S1_IDLE : 0);
+}
+
+/*! @brief Reads D, which underflows the hardware FIFO if it is empty.
+ */
+static uint8_t ReadD(void)
+{
+	uint8_t data = Receiver.HW[0];
+
+	if (Receiver.IdleRead)
+	{
+		Receiver.Idle = Receiver.IdleRead = false;
+		Receiver.Received = false;
+	}
+
+	// An underflow is followed by a flush, which leaves the hardware FIFO empty
+	if (Receiver.NbBytes == 0)
+		return 0;
+
+	memmove(&Receiver.HW[0], &Receiver.HW[1], --Receiver.NbBytes);
+	return data;
+}
+
+/*! @brief A character arrives on the line.
+ */
+static void Arrive(const uint8_t data)
+{
+	if (Receiver.NbBytes == Receiver.Depth)
+		Receiver.NbOverruns++;
+	else
+		Receiver.HW[Receiver.NbBytes++] = data;
+
+	Receiver.Received = true;
+}
+
+/*! @brief The line stays idle for a character time.
+ */
+static void LineIdle(void)
+{
+	if (Receiver.Received)
+		Receiver.Idle = true;
+}
+
+/*! @brief RxDrain - moves what the hardware FIFO holds to the receive FIFO.
+ */
+static uint8_t RxDrain(void)
+{
+	uint8_t nbBytes = Receiver.NbBytes;
+
+	for (uint8_t i = 0; i < nbBytes; i++)
+		FIFO_Put(&RxFIFO, ReadD());
+
+	return nbBytes;
+}
+
+/*! @brief ClearIdle - drains a waiting character, which clears IDLE, or reads D on its own.
+ */
+static uint8_t ClearIdle(void)
+{
+	if (Receiver.NbBytes)
+		return RxDrain();
+
+	(void)ReadD();
+	return 0;
+}
+
+/*! @brief RxIdleNeeded - whether the idle line interrupt is needed to end the burst.
+ */
+static bool RxIdleNeeded(void)
+{
+	return (Receiver.Watermark > 1) || RxFIFO.Dropping;
+}
+
+/*! @brief The receive half of IRQHandler.
+ *
+ *  @param naive TRUE to run it as a naive handler would.
+ */
+static void RxInterrupt(const bool naive)
+{
+	uint8_t nbBytes = 0;
+	uint8_t status = ReadS1();
+
+	if (status & S1_RDRF)
+	{
+		nbBytes += RxDrain();
+
+		if (RxIdleNeeded())
+			Receiver.IdleInterrupt = true;
+
+		if (!naive)
+			status = ReadS1();
+	}
+
+	if (Receiver.IdleInterrupt && (status & S1_IDLE))
+	{
+		// Trusting the IDLE read on entry, reading D while draining was taken to have cleared it
+		if (!naive || (nbBytes == 0))
+			nbBytes += ClearIdle();
+		else if (Receiver.NbBytes)
+			nbBytes += RxDrain();
+
+		FIFO_EndBurst(&RxFIFO);
+		if (naive || !RxIdleNeeded())
+			Receiver.IdleInterrupt = false;
+	}
+}
+
+/*! @brief Services the receive interrupt for as long as it is asserted.
+ *
+ *  @param naive Passed on to RxInterrupt.
+ */
+static void Service(const bool naive)
+{
+	int nbCalls = 0;
+
+	while ((Receiver.NbBytes >= Receiver.Watermark) || (Receiver.IdleInterrupt && Receiver.Idle))
+	{
+		RxInterrupt(naive);
+		CHECK(++nbCalls < 10); // an interrupt that is never cleared would hang the MCU
+	}
+}
+
+/*! @brief Resets the receiver and the receive FIFO.
+ *
+ *  @param depth The depth of the hardware FIFO.
+ *  @param watermark The receive watermark.
+ *  @param policy The receive FIFO's policy.
+ *  @param naive TRUE to start the idle line interrupt off, as a naive handler would.
+ */
+static void Reset(const uint8_t depth, const uint8_t watermark, const TFIFOPolicy policy, const bool naive)
+{
+	memset(&Receiver, 0, sizeof(Receiver));
+	Receiver.Depth = depth;
+	Receiver.Watermark = watermark;
+	FIFO_Init(&RxFIFO, policy);
+
+	// RxIRQMask
+	Receiver.IdleInterrupt = !naive && (watermark > 1);
+}
+
+/*! @brief Sends a packet split in two by a gap long enough for the line to go idle, as USB-serial bridges do.
+ *
+ *  @param naive Passed on to RxInterrupt.
+ *  @param first The number of bytes before the gap.
+ *  @return uint32_t - the number of bytes of the packet in the receive FIFO once the line has gone idle after it.
+ */
+static uint32_t SplitPacket(const bool naive, const int first)
+{
+	Reset(HW_FIFO_DEPTH, UART_RX_WATERMARK, FIFO_POLICY_REJECT, naive);
+
+	for (int i = 0; i < PACKET_NB_BYTES; i++)
+	{
+		if (i == first)
+		{
+			LineIdle();
+			Service(naive);
+		}
+
+		Arrive(i);
+		Service(naive);
+	}
+
+	LineIdle();
+	Service(naive);
+
+	return FIFO_NbBytes(&RxFIFO);
+}
+
+/*! @brief Checks that the rest of a burst being dropped on a 1-byte hardware FIFO is not let in by an earlier idle gap.
+ *
+ *  @param naive Passed on to RxInterrupt.
+ *  @return uint32_t - the number of bytes of the dropped burst that got into the receive FIFO.
+ */
+static uint32_t DroppedBurst(const bool naive)
+{
+	uint8_t data;
+
+	Reset(HW_FIFO_DEPTH_SMALL, 1, FIFO_POLICY_DROP_BURST, naive);
+
+	// A burst that fills the receive FIFO while the main loop is busy, then a gap
+	for (uint32_t i = 0; i < RX_FIFO_SIZE; i++)
+	{
+		Arrive(i);
+		Service(naive);
+	}
+	LineIdle();
+	Service(naive);
+
+	// The next burst overflows, and the main loop empties the receive FIFO before the rest of it arrives
+	Arrive(0xA0);
+	Service(naive);
+	while (FIFO_Get(&RxFIFO, &data))
+		;
+
+	for (int i = 1; i < PACKET_NB_BYTES; i++)
+	{
+		Arrive(0xA0 + i);
+		Service(naive);
+	}
+	LineIdle();
+	Service(naive);
+
+	return FIFO_NbBytes(&RxFIFO);
+}
+
+/*! @brief Checks that packets arriving with random gaps all reach the receive FIFO, in order, once the line goes idle.
+ *
+ *  @param depth The depth of the hardware FIFO.
+ *  @param watermark The receive watermark.
+ */
+static void TestRandomGaps(const uint8_t depth, const uint8_t watermark)
+{
+	uint8_t sent = 0, expected = 0, data;
+
+	Reset(depth, watermark, FIFO_POLICY_REJECT, false);
+
+	for (int p = 0; p < NB_PACKETS; p++)
+	{
+		for (int i = 0; i < PACKET_NB_BYTES; i++)
+		{
+			if (rand() % 4 == 0)
+			{
+				LineIdle();
+				Service(false);
+			}
+
+			Arrive(sent++);
+			Service(false);
+		}
+
+		LineIdle();
+		Service(false);
+
+		// Nothing is left in the hardware FIFO for the next packet to push out
+		CHECK(Receiver.NbBytes == 0);
+		while (FIFO_Get(&RxFIFO, &data))
+			CHECK(data == expected++);
+	}
+
+	CHECK((expected == sent) && (Receiver.NbOverruns == 0));
+}
+
+
+int main(void)
+{
+	srand(6);
+
+	// A naive handler strands a 3+2 split on the IDLE the gap left, read on entry as the 4th byte arrives, and a 4+1
+	// split because the idle line interrupt is off by the time the 5th byte arrives
+	for (int first = 1; first < PACKET_NB_BYTES; first++)
+	{
+		uint32_t nbBytes = SplitPacket(false, first);
+
+		printf("split %d+%d: %u bytes received, %u naive\n", first, PACKET_NB_BYTES - first, nbBytes, SplitPacket(true, first));
+		CHECK(nbBytes == PACKET_NB_BYTES);
+	}
+	CHECK(SplitPacket(true, 3) < PACKET_NB_BYTES);
+
+	printf("dropped burst: %u bytes let in, %u naive\n", DroppedBurst(false), DroppedBurst(true));
+	CHECK(DroppedBurst(false) == 0);
+	CHECK(DroppedBurst(true) > 0);
+
+	TestRandomGaps(HW_FIFO_DEPTH, UART_RX_WATERMARK);
+	TestRandomGaps(HW_FIFO_DEPTH, 1);
+	TestRandomGaps(HW_FIFO_DEPTH_SMALL, 1);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,18 @@
+/*! @file
+ *
+ *  @brief A host stand-in for the Events module, which records the events set.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include "Events.h"
+#include "Atomic\atomic.h"
+
+uint32_t volatile EventsStub_Set;
+
+
+void Events_Set(const TEvent event)
+{
+	Atomic_SetBits(&EventsStub_Set, event);
+}
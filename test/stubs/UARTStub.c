@@ -0,0 +1,96 @@
+/*! @file
+ *
+ *  @brief A host stand-in for the UART module, for testing the packet layer.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#include "UARTStub.h"
+
+FIFO_DEFINE(RxFIFO, UARTSTUB_RX_FIFO_SIZE);
+FIFO_DEFINE(TxFIFO, UARTSTUB_TX_FIFO_SIZE);
+
+TFIFO* const UARTStub_RxFIFO = &RxFIFO;
+TFIFO* const UARTStub_TxFIFO = &TxFIFO;
+
+TFIFOPolicy UARTStub_RxPolicy = FIFO_POLICY_REJECT;
+
+static void (*RxCallback)(void*);
+static void* RxCallbackArguments;
+
+
+void UARTStub_RxInterrupt(void)
+{
+	if (RxCallback)
+		RxCallback(RxCallbackArguments);
+}
+
+bool UART_Init(const TUARTPort port, const uint32_t baudRate)
+{
+	(void)port;
+	(void)baudRate;
+	RxCallback = NULL;
+	return FIFO_Init(&RxFIFO, UARTStub_RxPolicy) && FIFO_Init(&TxFIFO, FIFO_POLICY_REJECT);
+}
+
+void UART_SetRxCallback(const TUARTPort port, void (*userFunction)(void*), void* userArguments)
+{
+	(void)port;
+	RxCallback = userFunction;
+	RxCallbackArguments = userArguments;
+}
+
+bool UART_InChar(const TUARTPort port, uint8_t* const dataPtr)
+{
+	(void)port;
+	return FIFO_Get(&RxFIFO, dataPtr);
+}
+
+bool UART_OutChar(const TUARTPort port, const uint8_t data)
+{
+	(void)port;
+	return FIFO_Put(&TxFIFO, data);
+}
+
+size_t UART_Write(const TUARTPort port, const uint8_t* const data, const size_t length)
+{
+	(void)port;
+	return FIFO_PutN(&TxFIFO, data, length);
+}
+
+size_t UART_Read(const TUARTPort port, uint8_t* const dataPtr, const size_t length)
+{
+	(void)port;
+	return FIFO_GetN(&RxFIFO, dataPtr, length);
+}
+
+bool UART_RxPeek(const TUARTPort port, const uint8_t** const dataPtr, size_t* const lengthPtr)
+{
+	(void)port;
+	return FIFO_PeekContiguous(&RxFIFO, dataPtr, lengthPtr);
+}
+
+bool UART_RxConsume(const TUARTPort port, const size_t length)
+{
+	(void)port;
+	return FIFO_Consume(&RxFIFO, length);
+}
+
+bool UART_TxAvailable(const TUARTPort port, const size_t length)
+{
+	(void)port;
+	return FIFO_Space(&TxFIFO) >= length;
+}
+
+bool UART_TxReserve(const TUARTPort port, uint8_t** const dataPtr, size_t* const lengthPtr)
+{
+	(void)port;
+	return FIFO_Reserve(&TxFIFO, dataPtr, lengthPtr);
+}
+
+void UART_TxCommit(const TUARTPort port, const size_t length)
+{
+	(void)port;
+	FIFO_Commit(&TxFIFO, length);
+}
@@ -0,0 +1,35 @@
+/*! @file
+ *
+ *  @brief A host stand-in for the UART module, for testing the packet layer.
+ *
+ *  Every port shares one pair of FIFOs. A test plays the PC by putting bytes into UARTStub_RxFIFO and taking the
+ *  MCU's replies out of UARTStub_TxFIFO.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#ifndef UARTSTUB_H
+#define UARTSTUB_H
+
+#include "UART.h"
+
+// Sizes of the stand-in FIFOs, as UART_RX_FIFO_SIZE and UART_TX_FIFO_SIZE
+#ifndef UARTSTUB_RX_FIFO_SIZE
+#define UARTSTUB_RX_FIFO_SIZE 256
+#endif
+#ifndef UARTSTUB_TX_FIFO_SIZE
+#define UARTSTUB_TX_FIFO_SIZE 256
+#endif
+
+extern TFIFO* const UARTStub_RxFIFO;
+extern TFIFO* const UARTStub_TxFIFO;
+
+// The receive FIFO policy UART_Init sets up, as UART_RX_FIFO_POLICY
+extern TFIFOPolicy UARTStub_RxPolicy;
+
+/*! @brief Calls the receive callback, as the UART receive interrupt does once it has put data in the receive FIFO.
+ */
+void UARTStub_RxInterrupt(void);
+
+#endif
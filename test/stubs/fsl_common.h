@@ -0,0 +1,36 @@
+/*! @file
+ *
+ *  @brief Stands in for the SDK's fsl_common.h when the modules are built for the host.
+ *
+ *  Only what critical.h needs is provided. There are no interrupts on the host, so BASEPRI is an ordinary variable.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#ifndef FSL_COMMON_H
+#define FSL_COMMON_H
+
+#include <stdint.h>
+
+#define __NVIC_PRIO_BITS 4
+
+static uint32_t HostBASEPRI;
+
+static inline uint32_t __get_BASEPRI(void)
+{
+  return HostBASEPRI;
+}
+
+static inline void __set_BASEPRI(uint32_t value)
+{
+  HostBASEPRI = value;
+}
+
+static inline void __set_BASEPRI_MAX(uint32_t value)
+{
+  if ((value != 0) && ((HostBASEPRI == 0) || (value < HostBASEPRI)))
+    HostBASEPRI = value;
+}
+
+#endif
@@ -0,0 +1,31 @@
+/*! @file
+ *
+ *  @brief Checks shared by the host-built unit tests.
+ *
+ *  A failed CHECK reports where it failed and the test carries on, so one run shows every failure.
+ *  A test's main returns TEST_RESULT(), which is non-zero if any check failed.
+ *
+ *  @author Uldis Bagley and Prashant Shrestha
+ *  @date 2020-06-04
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int TestNbFailures;
+
+#define CHECK(condition) \
+  do \
+  { \
+    if (!(condition)) \
+    { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      TestNbFailures++; \
+    } \
+  } while (0)
+
+#define TEST_RESULT() (printf("%s\n", TestNbFailures ? "FAILED" : "passed"), (TestNbFailures != 0))
+
+#endif